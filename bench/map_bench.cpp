@@ -0,0 +1,367 @@
+/*
+ * Throughput and latency benchmark of sjtu::map against std::map.
+ *
+ * build:  g++ -std=c++17 -O2 -DNDEBUG -Isrc -Idata bench/map_bench.cpp -o map_bench
+ * run:    ./map_bench [--max-size N] [--heavy-max-size N] [--impl sjtu|std|both]
+ *                     [--only SUBSTRING] [--baseline OLD.csv] [--tolerance 0.10]
+ *
+ * Every (implementation, key type, access pattern, size, operation) is one
+ * CSV row on stdout:
+ *     impl,key,value,pattern,size,op,ops,ns_per_op,p50_ns,p99_ns,p999_ns
+ * ns_per_op comes from timing the whole loop; the percentiles from timing a
+ * sample of single operations inside it (empty for iterate and copy, which
+ * are measured as a whole). Sizes go from 1e3 up to --max-size (default 1e6,
+ * up to 1e8) in powers of ten; the heavy key and value types (Bint, Matrix)
+ * stop at --heavy-max-size (default 1e4), since every Bint owns 8 KB.
+ *
+ * --only keeps the cases whose "impl,key,value,pattern,size" contains the
+ * given text, e.g. --only sjtu,string or --only zipfian.
+ *
+ * With --baseline the sjtu rows are compared against a CSV written by an
+ * earlier run: every row more than --tolerance slower is reported on stderr
+ * and the exit status is 1, so the benchmark can gate a change.
+ */
+#include "map.hpp"
+#include "class-bint.hpp"
+#include "class-matrix.hpp"
+#include <map>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    unsigned long long max_size = 1000000;
+    unsigned long long heavy_max_size = 10000;
+    bool run_sjtu = true, run_std = true;
+    std::string only;
+    std::string baseline;
+    double tolerance = 0.10;
+};
+
+struct Result {
+    std::string impl, key, value, pattern, op;
+    unsigned long long size = 0, ops = 0;
+    double ns_per_op = 0;
+    std::vector<double> samples; // single operations, in ns
+
+    std::string id() const {
+        return key + ',' + value + ',' + pattern + ',' + std::to_string(size) + ',' + op;
+    }
+};
+
+std::vector<Result> results;
+
+double percentile(std::vector<double> &v, double p) {
+    size_t k = static_cast<size_t>(p * (v.size() - 1));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+void report(Result &r) {
+    std::printf("%s,%s,%s,%s,%llu,%s,%llu,%.2f", r.impl.c_str(), r.key.c_str(), r.value.c_str(), r.pattern.c_str(),
+                r.size, r.op.c_str(), r.ops, r.ns_per_op);
+    if (r.samples.empty()) {
+        std::printf(",,,\n");
+    } else {
+        double p50 = percentile(r.samples, 0.50), p99 = percentile(r.samples, 0.99);
+        double p999 = percentile(r.samples, 0.999);
+        std::printf(",%.0f,%.0f,%.0f\n", p50, p99, p999);
+    }
+    std::fflush(stdout);
+    r.samples.clear();
+    results.push_back(r);
+}
+
+// Zipfian ranks in [0, n) with skew theta, as generated by YCSB (Gray et
+// al., "Quickly generating billion-record synthetic databases"): O(n) setup,
+// O(1) per draw and no table.
+class Zipfian {
+private:
+    unsigned long long n;
+    double theta, alpha, zetan, eta;
+    std::uniform_real_distribution<double> unit;
+
+public:
+    Zipfian(unsigned long long items, double skew) : n(items), theta(skew), unit(0.0, 1.0) {
+        double zeta2 = 0;
+        zetan = 0;
+        for (unsigned long long i = 1; i <= n; ++i) {
+            zetan += 1.0 / std::pow(static_cast<double>(i), theta);
+            if (i == 2) zeta2 = zetan;
+        }
+        if (n < 2) zeta2 = zetan;
+        alpha = 1.0 / (1.0 - theta);
+        eta = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+    }
+
+    template<class Rng>
+    unsigned long long operator()(Rng &rng) {
+        double u = unit(rng), uz = u * zetan;
+        if (uz < 1.0) return 0;
+        if (uz < 1.0 + std::pow(0.5, theta)) return n > 1 ? 1 : 0;
+        unsigned long long r = static_cast<unsigned long long>(n * std::pow(eta * u - eta + 1.0, alpha));
+        return r < n ? r : n - 1;
+    }
+};
+
+// The order in which the keys of a map of size n are touched, as indices
+// into its (ascending) key list.
+std::vector<unsigned long long> accessOrder(const std::string &pattern, unsigned long long n, std::mt19937_64 &rng) {
+    std::vector<unsigned long long> order(n);
+    for (unsigned long long i = 0; i < n; ++i) order[i] = i;
+    if (pattern == "sequential") return order;
+    std::shuffle(order.begin(), order.end(), rng);
+    if (pattern == "random") return order;
+    // zipfian: hot ranks are mapped through the shuffle, so the hot keys are
+    // spread over the whole tree instead of sitting at its left edge.
+    Zipfian zipf(n, 0.99);
+    std::vector<unsigned long long> draws(n);
+    for (unsigned long long i = 0; i < n; ++i) draws[i] = order[zipf(rng)];
+    return draws;
+}
+
+// Keys are increasing in their index, so the sequential pattern inserts in
+// key order.
+template<class K>
+struct KeyMaker;
+
+template<>
+struct KeyMaker<int> {
+    static const char *name() { return "int"; }
+    static int make(unsigned long long i) { return static_cast<int>(i); }
+};
+
+template<>
+struct KeyMaker<std::string> {
+    static const char *name() { return "string"; }
+    static std::string make(unsigned long long i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "user:%012llu", i);
+        return buf;
+    }
+};
+
+template<>
+struct KeyMaker<Util::Bint> {
+    static const char *name() { return "Bint"; }
+    static Util::Bint make(unsigned long long i) {
+        return Util::Bint(static_cast<long long>(i) * 1000003LL);
+    }
+};
+
+template<class V>
+struct ValueMaker;
+
+template<>
+struct ValueMaker<int> {
+    static const char *name() { return "int"; }
+    static int make() { return 1; }
+};
+
+template<>
+struct ValueMaker<Diamond::Matrix<double> > {
+    static const char *name() { return "Matrix"; }
+    static Diamond::Matrix<double> make() { return Diamond::Matrix<double>(4, 4, 1.0); }
+};
+
+// Times the loop as a whole and every stride-th iteration on its own.
+// prepare() runs untimed before every repetition.
+template<class P, class F>
+void measure(Result &r, unsigned long long reps, unsigned long long n, P prepare, F body) {
+    const unsigned long long wanted = 100000;
+    unsigned long long stride = reps * n > wanted ? reps * n / wanted : 1;
+    r.ops = reps * n;
+    r.samples.reserve(static_cast<size_t>(r.ops / stride + 1));
+    double total = 0;
+    unsigned long long step = 0;
+    for (unsigned long long rep = 0; rep < reps; ++rep) {
+        prepare();
+        Clock::time_point start = Clock::now();
+        for (unsigned long long i = 0; i < n; ++i, ++step) {
+            if (step % stride == 0) {
+                Clock::time_point t0 = Clock::now();
+                body(i);
+                r.samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - t0).count());
+            } else {
+                body(i);
+            }
+        }
+        total += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+    r.ns_per_op = total / r.ops;
+}
+
+volatile unsigned long long sink;
+
+template<class Map, class K, class V>
+void runCase(const Options &opt, const char *impl, const std::string &pattern, unsigned long long n) {
+    typedef typename Map::value_type value_type;
+    Result r;
+    r.impl = impl;
+    r.key = KeyMaker<K>::name();
+    r.value = ValueMaker<V>::name();
+    r.pattern = pattern;
+    r.size = n;
+    if (!opt.only.empty() && (r.impl + ',' + r.id()).find(opt.only) == std::string::npos) return;
+
+    std::mt19937_64 rng(n * 31 + pattern.size());
+    std::vector<K> keys;
+    keys.reserve(n);
+    for (unsigned long long i = 0; i < n; ++i) keys.push_back(KeyMaker<K>::make(i));
+    std::vector<unsigned long long> order = accessOrder(pattern, n, rng);
+    V value = ValueMaker<V>::make();
+    // Small maps are rebuilt and measured several times to get past the
+    // clock's resolution.
+    unsigned long long reps = n >= 200000 ? 1 : 200000 / n;
+
+    // insert: into an empty map
+    {
+        Map m;
+        r.op = "insert";
+        measure(r, reps, n, [&] { m.clear(); }, [&](unsigned long long i) {
+            m.insert(value_type(keys[order[i]], value));
+        });
+        report(r);
+    }
+
+    // The other operations work on a map with every key.
+    Map full;
+    for (unsigned long long i = 0; i < n; ++i) full.insert(value_type(keys[i], value));
+
+    r.op = "find";
+    unsigned long long found = 0;
+    measure(r, reps, n, [] {}, [&](unsigned long long i) {
+        found += full.find(keys[order[i]]) != full.end();
+    });
+    sink = found;
+    report(r);
+
+    r.op = "iterate";
+    {
+        Clock::time_point start = Clock::now();
+        unsigned long long steps = 0;
+        for (unsigned long long rep = 0; rep < reps; ++rep) {
+            for (typename Map::const_iterator it = full.cbegin(); it != full.cend(); ++it) ++steps;
+        }
+        sink = steps;
+        r.ops = reps * n;
+        r.ns_per_op = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / r.ops;
+        report(r);
+    }
+
+    r.op = "copy";
+    {
+        double total = 0;
+        for (unsigned long long rep = 0; rep < reps; ++rep) {
+            Clock::time_point start = Clock::now();
+            Map copy(full);
+            total += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            sink = copy.size();
+        }
+        r.ops = reps * n;
+        r.ns_per_op = total / r.ops;
+        report(r);
+    }
+
+    // erase: the keys of the pattern from a full copy
+    {
+        Map m;
+        r.op = "erase";
+        measure(r, reps, n, [&] { m = full; }, [&](unsigned long long i) {
+            m.erase(keys[order[i]]);
+        });
+        report(r);
+    }
+}
+
+template<class K, class V>
+void runType(const Options &opt, unsigned long long max_size) {
+    static const char *patterns[] = {"sequential", "random", "zipfian"};
+    for (unsigned long long n = 1000; n <= max_size && n <= 100000000ULL; n *= 10) {
+        for (const char *pattern : patterns) {
+            if (opt.run_sjtu) runCase<sjtu::map<K, V>, K, V>(opt, "sjtu", pattern, n);
+            if (opt.run_std) runCase<std::map<K, V>, K, V>(opt, "std", pattern, n);
+        }
+    }
+}
+
+// Compares the sjtu rows of this run with those of an earlier one.
+int compareBaseline(const Options &opt) {
+    std::ifstream in(opt.baseline.c_str());
+    if (!in) {
+        std::fprintf(stderr, "cannot read baseline %s\n", opt.baseline.c_str());
+        return 2;
+    }
+    std::map<std::string, double> before;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::vector<std::string> f;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ',')) f.push_back(field);
+        if (f.size() < 8 || f[0] != "sjtu") continue;
+        before[f[1] + ',' + f[2] + ',' + f[3] + ',' + f[4] + ',' + f[5]] = std::atof(f[7].c_str());
+    }
+    int regressions = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        if (r.impl != "sjtu") continue;
+        std::map<std::string, double>::const_iterator it = before.find(r.id());
+        if (it == before.end() || it->second <= 0) continue;
+        double ratio = r.ns_per_op / it->second;
+        if (ratio > 1.0 + opt.tolerance) {
+            std::fprintf(stderr, "REGRESSION %s: %.2f ns/op, was %.2f (%+.0f%%)\n", r.id().c_str(), r.ns_per_op,
+                         it->second, (ratio - 1.0) * 100);
+            ++regressions;
+        }
+    }
+    std::fprintf(stderr, "%d regression(s) against %s\n", regressions, opt.baseline.c_str());
+    return regressions > 0 ? 1 : 0;
+}
+
+void usage() {
+    std::fprintf(stderr, "usage: map_bench [--max-size N] [--heavy-max-size N] [--impl sjtu|std|both]\n"
+                         "                 [--only SUBSTRING] [--baseline OLD.csv] [--tolerance 0.10]\n");
+    std::exit(2);
+}
+
+}
+
+int main(int argc, char **argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (i + 1 >= argc) usage();
+        std::string v = argv[++i];
+        if (a == "--max-size") opt.max_size = std::strtoull(v.c_str(), nullptr, 10);
+        else if (a == "--heavy-max-size") opt.heavy_max_size = std::strtoull(v.c_str(), nullptr, 10);
+        else if (a == "--impl") {
+            opt.run_sjtu = v != "std";
+            opt.run_std = v != "sjtu";
+        } else if (a == "--only") opt.only = v;
+        else if (a == "--baseline") opt.baseline = v;
+        else if (a == "--tolerance") opt.tolerance = std::atof(v.c_str());
+        else usage();
+    }
+
+    std::printf("impl,key,value,pattern,size,op,ops,ns_per_op,p50_ns,p99_ns,p999_ns\n");
+    runType<int, int>(opt, opt.max_size);
+    runType<std::string, int>(opt, opt.max_size);
+    runType<Util::Bint, int>(opt, opt.heavy_max_size);
+    runType<int, Diamond::Matrix<double> >(opt, opt.heavy_max_size);
+
+    return opt.baseline.empty() ? 0 : compareBaseline(opt);
+}
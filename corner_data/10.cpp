@@ -0,0 +1,48 @@
+#include "src.hpp"
+#include <iostream>
+
+template <class Map>
+void dump(const Map &map) {
+    std::cout << map.size() << ':';
+    for (auto it = map.cbegin(); it != map.cend(); ++it) std::cout << ' ' << it->first;
+    std::cout << '\n';
+}
+
+signed main() {
+    sjtu::map <int, int> map;
+    for (int i = 0; i < 100; i += 2) map[i] = i;
+
+    // Bounds land on the first key not below / above the probe.
+    std::cout << map.lower_bound(10)->first << ' ' << map.lower_bound(11)->first << '\n';
+    std::cout << map.upper_bound(10)->first << ' ' << map.upper_bound(11)->first << '\n';
+    std::cout << (map.lower_bound(99) == map.end()) << ' ' << (map.upper_bound(-1) == map.begin()) << '\n';
+    auto range = map.equal_range(42);
+    std::cout << range.first->first << ' ' << range.second->first << '\n';
+    auto missing = map.equal_range(43);
+    std::cout << (missing.first == missing.second) << ' ' << missing.first->first << '\n';
+    const sjtu::map <int, int> &view = map;
+    auto crange = view.equal_range(98);
+    std::cout << crange.first->first << ' ' << (crange.second == view.cend()) << '\n';
+
+    // Erase by key reports how many elements went away.
+    std::cout << map.erase(0) << ' ' << map.erase(1) << '\n';
+
+    // A short range is erased element by element...
+    auto it = map.erase(map.lower_bound(10), map.lower_bound(20));
+    std::cout << it->first << '\n';
+    dump(map);
+    // ...a long one by rebuilding what is left; the map stays fully usable.
+    it = map.erase(map.lower_bound(30), map.end());
+    std::cout << (it == map.end()) << '\n';
+    dump(map);
+    for (int i = 1; i < 40; i += 2) map[i] = i;
+    map.erase(map.begin(), map.lower_bound(7));
+    dump(map);
+    it = map.erase(map.lower_bound(9), map.lower_bound(35));
+    std::cout << it->first << '\n';
+    dump(map);
+    map.erase(map.begin(), map.end());
+    dump(map);
+    map[5] = 5;
+    dump(map);
+}
@@ -0,0 +1,57 @@
+#include "src.hpp"
+#include <iostream>
+
+typedef sjtu::map <int, int, std::less<int>, sjtu::order_statistics_policy> ranked;
+
+// Walks the whole map, so it is the slow answer nth() and rank() must match.
+int wrong_ranks(const ranked &map) {
+    int wrong = 0;
+    size_t k = 0;
+    for (auto it = map.cbegin(); it != map.cend(); ++it, ++k) {
+        wrong += map.nth(k) != it || map.rank(it->first) != k || map.distance(map.cbegin(), it) != k;
+    }
+    return wrong + (map.nth(k) != map.cend());
+}
+
+signed main() {
+    ranked map;
+    std::cout << (map.nth(0) == map.end()) << ' ' << map.rank(5) << ' ' << map.distance(map.cbegin(), map.cend())
+              << '\n';
+
+    for (int i = 0; i < 1000; ++i) map[(i * 37) % 1000 * 2] = i;
+    std::cout << map.nth(0)->first << ' ' << map.nth(999)->first << ' ' << (map.nth(1000) == map.end()) << '\n';
+    // rank() counts the smaller keys, whether key is in the map or not.
+    std::cout << map.rank(-1) << ' ' << map.rank(0) << ' ' << map.rank(1) << ' ' << map.rank(1000) << ' '
+              << map.rank(1001) << ' ' << map.rank(5000) << '\n';
+    std::cout << map.distance(map.find(100), map.find(300)) << ' ' << map.distance(map.cbegin(), map.cend())
+              << ' ' << map.distance(map.find(42), map.find(42)) << '\n';
+    std::cout << wrong_ranks(map) << '\n';
+
+    // The subtree sizes stay right through erasure, insertion and copies.
+    for (int i = 0; i < 2000; i += 6) map.erase(map.find(i));
+    for (int i = 1; i < 2000; i += 10) map.insert({i, -i});
+    ranked copy = map;
+    copy.erase(copy.begin());
+    std::cout << map.size() << ' ' << wrong_ranks(map) << ' ' << copy.size() << ' ' << wrong_ranks(copy) << ' '
+              << copy.nth(0)->first << '\n';
+
+    // ... and through split and join.
+    ranked high = map.split(1000);
+    std::cout << map.size() << ' ' << high.size() << ' ' << wrong_ranks(map) << ' ' << wrong_ranks(high) << ' '
+              << high.nth(0)->first << ' ' << high.rank(1000) << '\n';
+    map.join(high);
+    std::cout << map.size() << ' ' << wrong_ranks(map) << ' ' << map.rank(1001) << '\n';
+
+    // distance() needs first not after last, and both from this map.
+    try {
+        map.distance(map.find(300), map.find(100));
+    } catch (sjtu::invalid_iterator &) {
+        std::cout << "backwards" << '\n';
+    }
+    try {
+        map.distance(copy.cbegin(), map.cend());
+    } catch (sjtu::invalid_iterator &) {
+        std::cout << "foreign" << '\n';
+    }
+    return 0;
+}
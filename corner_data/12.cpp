@@ -0,0 +1,108 @@
+#include "src.hpp"
+#include <iostream>
+
+// Copies throw once a budget runs out; alive counts the live objects.
+struct fragile {
+    static int alive, budget;
+    int v;
+    fragile(int v) : v(v) { ++alive; }
+    fragile(const fragile &o) : v(o.v) {
+        if (budget-- == 0) throw 0;
+        ++alive;
+    }
+    ~fragile() { --alive; }
+};
+int fragile::alive = 0, fragile::budget = -1;
+
+typedef sjtu::map <int, fragile> Map;
+
+// Throws once its own budget of comparisons runs out.
+struct touchy_less {
+    static int budget;
+    bool operator()(int a, int b) const {
+        if (budget-- == 0) throw 1;
+        return a < b;
+    }
+};
+int touchy_less::budget = -1;
+
+// Size, elements reached by iteration, and whether they are in order.
+void check(const Map &map) {
+    int reached = 0, ordered = 1, prev = -1;
+    for (auto it = map.cbegin(); it != map.cend(); ++it, ++reached) {
+        if (it->first <= prev || it->second.v != it->first * 10) ordered = 0;
+        prev = it->first;
+    }
+    std::cout << map.size() << ' ' << reached << ' ' << ordered << '\n';
+}
+
+signed main() {
+    // Ten increasing keys, then the input goes backwards: the first ten are
+    // loaded as a vine, the rest is inserted one by one, partly behind the
+    // last node of the vine.
+    sjtu::pair<const int, fragile> *input[20];
+    for (int i = 0; i < 20; ++i) {
+        int key = i < 10 ? 2 * i : i % 2 == 0 ? 2 * (i - 10) + 1 : 50 + i;
+        input[i] = new sjtu::pair<const int, fragile>(key, fragile(key * 10));
+    }
+    struct iter {
+        sjtu::pair<const int, fragile> **p;
+        const sjtu::pair<const int, fragile> &operator*() const { return **p; }
+        iter &operator++() { ++p; return *this; }
+        bool operator!=(const iter &o) const { return p != o.p; }
+    };
+    iter first = {input}, last = {input + 20};
+    const int budgets[] = {4, 15, -1};
+    for (int budget : budgets) {
+        // assign() throwing while the vine is built and after it became the tree
+        {
+            Map map;
+            for (int i = 100; i < 105; ++i) map.insert({i, fragile(i * 10)});
+            fragile::budget = budget;
+            try {
+                map.assign(first, last);
+                std::cout << "assigned ";
+            } catch (int) {
+                std::cout << "assign threw ";
+            }
+            fragile::budget = -1;
+            check(map);
+            map.insert({21, fragile(210)});
+            map.erase(0);
+            check(map);
+        }
+        // the range constructor cleans up after itself
+        fragile::budget = budget;
+        try {
+            Map map(first, last);
+            fragile::budget = -1;
+            std::cout << "built ";
+            check(map);
+        } catch (int) {
+            std::cout << "constructor threw\n";
+        }
+        fragile::budget = -1;
+        std::cout << fragile::alive << '\n';
+    }
+    // a comparator that throws on a node just created, both while the vine
+    // is built and when the input has gone backwards
+    for (int budget : {0, 5, 12}) {
+        sjtu::map <int, fragile, touchy_less> map;
+        touchy_less::budget = budget;
+        try {
+            map.assign(first, last);
+            std::cout << "assigned ";
+        } catch (int) {
+            std::cout << "compare threw ";
+        }
+        touchy_less::budget = -1;
+        size_t reached = 0;
+        for (auto it = map.cbegin(); it != map.cend(); ++it) ++reached;
+        std::cout << map.size() << ' ' << reached << ' ';
+        map.clear();
+        std::cout << fragile::alive << '\n';
+    }
+    for (int i = 0; i < 20; ++i) delete input[i];
+    std::cout << fragile::alive << '\n';
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include "src.hpp"
+#include <iostream>
+
+template <class Map>
+void dump(const Map &map) {
+    std::cout << map.size() << ':';
+    for (auto it = map.cbegin(); it != map.cend(); ++it) std::cout << ' ' << it->first << '=' << it->second;
+    std::cout << '\n';
+}
+
+signed main() {
+    sjtu::map <int, int> map;
+    // Streaming ingestion feeds end() as the hint.
+    for (int i = 0; i < 100000; ++i) map.insert(map.end(), {i * 2, i});
+    std::cout << map.size() << ' ' << map.begin()->first << ' ' << (--map.end())->first << '\n';
+    map.clear();
+
+    // Hints that point right after the new key.
+    auto it = map.insert(map.end(), {50, 0});
+    it = map.insert(it, {40, 1});
+    it = map.insert(it, {30, 2});
+    map.insert(map.begin(), {10, 3});
+    map.insert(map.find(40), {35, 4});
+    // Wrong hints still end up in the right place.
+    map.insert(map.begin(), {60, 5});
+    map.insert(map.end(), {20, 6});
+    map.insert(map.find(10), {45, 7});
+    dump(map);
+
+    // An existing key is never replaced; the iterator points at it.
+    it = map.insert(map.find(50), {30, 100});
+    std::cout << it->first << ' ' << it->second << '\n';
+    it = map.emplace_hint(map.end(), 70, 8);
+    std::cout << it->first << ' ' << it->second << '\n';
+    it = map.emplace_hint(map.begin(), 70, 9);
+    std::cout << it->first << ' ' << it->second << '\n';
+    map.emplace_hint(map.find(35), 33, 10);
+    dump(map);
+
+    // Descending input with begin() as the hint is just as cheap.
+    sjtu::map <int, int> down;
+    for (int i = 1000; i > 0; --i) down.insert(down.begin(), {i, -i});
+    std::cout << down.size() << ' ' << down.begin()->second << ' ' << (--down.end())->second << '\n';
+}
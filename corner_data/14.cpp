@@ -0,0 +1,56 @@
+#include "src.hpp"
+#include <iostream>
+#include <string>
+
+template <class Map>
+void dump(const Map &map) {
+    std::cout << map.size() << ':';
+    for (auto it = map.cbegin(); it != map.cend(); ++it) std::cout << ' ' << it->first << '=' << it->second;
+    std::cout << '\n';
+}
+
+signed main() {
+    sjtu::btree_map <int, int> map;
+    // Enough keys for several levels of inner nodes.
+    for (int i = 0; i < 200000; ++i) map[(i * 7919) % 200000] = i;
+    std::cout << map.size() << ' ' << map.begin()->first << ' ' << (--map.end())->first << '\n';
+    long long sum = 0;
+    for (auto it = map.cbegin(); it != map.cend(); ++it) sum += it->first;
+    std::cout << sum << '\n';
+
+    // Erase all but every 1000th key, split between both overloads.
+    for (int i = 0; i < 200000; ++i) {
+        if (i % 1000 == 0) continue;
+        if (i % 2) map.erase(i); else map.erase(map.find(i));
+    }
+    std::cout << map.size() << ' ' << map.count(5000) << ' ' << map.count(5001) << '\n';
+    std::cout << map.lower_bound(5001)->first << ' ' << map.upper_bound(5000)->first << ' '
+              << (map.lower_bound(199001) == map.end()) << '\n';
+
+    // Walking backwards crosses every leaf boundary.
+    auto it = map.end();
+    int steps = 0;
+    while (it != map.begin()) --it, ++steps;
+    std::cout << steps << '\n';
+
+    // Copies are deep; the source is untouched.
+    auto copy = map;
+    copy.erase(0);
+    copy.insert({1, 1});
+    std::cout << map.count(0) << ' ' << copy.count(0) << ' ' << copy.size() << '\n';
+
+    sjtu::btree_map <std::string, std::string> words;
+    for (int i = 0; i < 300; ++i) words[std::to_string(i % 37) + "/" + std::to_string(i)] = std::string(i % 5, 'x');
+    for (int i = 0; i < 300; i += 3) words.erase(std::to_string(i % 37) + "/" + std::to_string(i));
+    std::cout << words.size() << ' ' << words.begin()->first << ' ' << (--words.end())->first << '\n';
+
+    sjtu::btree_map <int, int> small;
+    for (int i = 0; i < 10; ++i) small.insert({i, i * i});
+    std::cout << small.insert({3, 0}).second << ' ' << small.at(3) << '\n';
+    dump(small);
+
+    try { small.at(10); } catch (...) { std::cout << "at\n"; }
+    while (!small.empty()) small.erase(small.begin());
+    std::cout << (small.begin() == small.end()) << '\n';
+    return 0;
+}
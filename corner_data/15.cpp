@@ -0,0 +1,128 @@
+#include "src.hpp"
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+
+// Ordered like std::less and std::greater, but not known to be, so maps
+// using them take the binary search instead of the counting kernels.
+template<class T>
+struct plain_less {
+    bool operator()(const T &a, const T &b) const { return a < b; }
+};
+template<class T>
+struct plain_greater {
+    bool operator()(const T &a, const T &b) const { return b < a; }
+};
+
+unsigned long long seed = 88172645463325252ull;
+unsigned long long next() {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return seed;
+}
+
+// A value of T that is often an extreme, zero or a neighbour of them.
+template<class T>
+T pick() {
+    typedef std::numeric_limits<T> lim;
+    switch (next() % 8) {
+        case 0: return lim::max();
+        case 1: return lim::lowest();
+        case 2: return T(0);
+        case 3: return T(lim::is_signed ? -1 : 1);
+        case 4: return T(next() % 16);
+        default: return T(next());
+    }
+}
+template<>
+float pick<float>() {
+    switch (next() % 8) {
+        case 0: return std::numeric_limits<float>::infinity();
+        case 1: return -std::numeric_limits<float>::max();
+        case 2: return next() % 2 ? 0.0f : -0.0f;
+        case 3: return std::numeric_limits<float>::denorm_min();
+        case 4: return float(next() % 16) / 4;
+        default: return float(int64_t(next())) / 1e9f;
+    }
+}
+template<>
+double pick<double>() {
+    switch (next() % 8) {
+        case 0: return -std::numeric_limits<double>::infinity();
+        case 1: return std::numeric_limits<double>::max();
+        case 2: return next() % 2 ? 0.0 : -0.0;
+        case 3: return -std::numeric_limits<double>::denorm_min();
+        case 4: return double(next() % 16) / 4;
+        default: return double(int64_t(next())) / 1e9;
+    }
+}
+
+// Every counting kernel against the scalar loop, for every length up to a
+// few vectors past the widest lane count, so that each kernel also runs its
+// scalar tail.
+template<class T>
+int kernels_agree() {
+    T keys[70];
+    int wrong = 0;
+    for (size_t n = 0; n <= 67; ++n) {
+        for (int round = 0; round < 20; ++round) {
+            for (size_t i = 0; i < n; ++i) keys[i] = pick<T>();
+            T key = n > 0 && round % 2 ? keys[next() % n] : pick<T>();
+            wrong += sjtu::detail::lane_count<T, false>::before(keys, n, key) !=
+                     sjtu::detail::count_before_scalar<false>(keys, 0, n, key);
+            wrong += sjtu::detail::lane_count<T, true>::before(keys, n, key) !=
+                     sjtu::detail::count_before_scalar<true>(keys, 0, n, key);
+        }
+    }
+    return wrong;
+}
+
+// Lookups of a counted map against the same map searched with comp().
+template<class T, class Counted, class Plain>
+int maps_agree() {
+    sjtu::btree_map <T, int, Counted> counted;
+    sjtu::btree_map <T, int, Plain> plain;
+    int wrong = 0;
+    for (int i = 0; i < 3000; ++i) {
+        T key = pick<T>();
+        counted[key] = i;
+        plain[key] = i;
+        if (i % 3 == 0) {
+            T gone = pick<T>();
+            wrong += counted.erase(gone) != plain.erase(gone);
+        }
+    }
+    wrong += counted.size() != plain.size();
+    for (int i = 0; i < 3000; ++i) {
+        T key = pick<T>();
+        auto c = counted.find(key);
+        auto p = plain.find(key);
+        wrong += (c == counted.end()) != (p == plain.end()) || (c != counted.end() && c->second != p->second);
+        auto cl = counted.lower_bound(key), cu = counted.upper_bound(key);
+        auto pl = plain.lower_bound(key), pu = plain.upper_bound(key);
+        wrong += (cl == counted.end()) != (pl == plain.end()) || (cl != counted.end() && cl->second != pl->second);
+        wrong += (cu == counted.end()) != (pu == plain.end()) || (cu != counted.end() && cu->second != pu->second);
+    }
+    return wrong;
+}
+
+template<class T>
+void check(const char *name) {
+    std::cout << name << ' ' << kernels_agree<T>() << ' '
+              << maps_agree<T, std::less<T>, plain_less<T> >() << ' '
+              << maps_agree<T, std::greater<T>, plain_greater<T> >() << '\n';
+}
+
+signed main() {
+    check<int32_t>("int32");
+    check<uint32_t>("uint32");
+    check<int64_t>("int64");
+    check<uint64_t>("uint64");
+    check<float>("float");
+    check<double>("double");
+    check<short>("short");
+    check<unsigned char>("uchar");
+    return 0;
+}
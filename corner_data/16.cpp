@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+// The tree itself is private; the standard headers come first so that only
+// the map is opened up.
+#define private public
+#include "src.hpp"
+#undef private
+
+unsigned long long seed = 2463534242ull;
+unsigned next() {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return static_cast<unsigned>(seed);
+}
+
+struct alignas(64) wide {
+    int v;
+    wide(int x = 0) : v(x) {}
+};
+
+// Walks the subtree of x and returns its black height, or -1 if a red node
+// has a red child, a parent link is wrong, the keys are out of order or the
+// black heights of two siblings differ.
+template<class Map>
+int blackHeight(const Map &map, const typename Map::NodeBase *x, const typename Map::NodeBase *parent) {
+    if (x == nullptr) return 1;
+    if (x->parent() != parent) return -1;
+    if (parent != &map.header && parent->red() && x->red()) return -1;
+    if (x->left != nullptr && !map.comp(Map::keyOf(x->left), Map::keyOf(x))) return -1;
+    if (x->right != nullptr && !map.comp(Map::keyOf(x), Map::keyOf(x->right))) return -1;
+    int l = blackHeight(map, x->left, x), r = blackHeight(map, x->right, x);
+    if (l < 0 || l != r) return -1;
+    return l + !x->red();
+}
+
+// Whether the whole map is a red-black tree: a black root, the header's
+// links at the ends, and the size matching the nodes reached.
+template<class Map>
+bool valid(const Map &map) {
+    typename Map::NodeBase *root = map.root();
+    if (root == nullptr) return map.size() == 0 && map.header.left == &map.header;
+    if (root->red() || blackHeight(map, root, &map.header) < 0) return false;
+    size_t n = 0;
+    for (auto it = map.cbegin(); it != map.cend(); ++it) ++n;
+    return n == map.size() && map.header.left == Map::minimum(root) && map.header.right == Map::maximum(root);
+}
+
+// Random insertions and erasures over a small key range, so that most
+// operations hit a full tree; checks the tree every few steps.
+template<class Map, class MakeKey, class MakeValue>
+void churn(const char *name, MakeKey key_of, MakeValue value_of) {
+    Map map;
+    int broken = 0, checks = 0;
+    for (int step = 0; step < 20000; ++step) {
+        int key = static_cast<int>(next() % 600);
+        if (next() % 3 != 0) {
+            map.insert({key_of(key), value_of(key)});
+        } else {
+            auto it = map.find(key_of(key));
+            if (it != map.end()) map.erase(it);
+        }
+        if (step % 97 == 0) {
+            broken += !valid(map);
+            ++checks;
+        }
+    }
+    // down to nothing from one end, and back
+    while (map.size() > 100) map.erase(map.begin());
+    broken += !valid(map);
+    while (!map.empty()) map.erase(--map.end());
+    broken += !valid(map);
+    for (int i = 0; i < 1000; ++i) map.insert({key_of(i), value_of(i)});
+    Map copy(map);
+    broken += !valid(map) + !valid(copy);
+    std::cout << name << ' ' << broken << ' ' << checks << ' ' << copy.size() << '\n';
+}
+
+signed main() {
+    auto number = [](int k) { return k; };
+    auto letter = [](int k) { return static_cast<char>(k % 128); };
+    auto text = [](int k) { return std::to_string(k); };
+    churn<sjtu::map <int, int> >("int", number, number);
+    churn<sjtu::map <char, char> >("char", letter, letter);
+    churn<sjtu::map <int, wide> >("wide", number, [](int k) { return wide(k); });
+    churn<sjtu::map <std::string, std::string> >("string", text, text);
+    churn<sjtu::map <int, int, std::greater<int> > >("greater", number, number);
+    churn<sjtu::map <int, int, std::less<int>, sjtu::order_statistics_policy> >("ranked", number, number);
+
+    // the color shares the word of the parent link
+    std::cout << sizeof(sjtu::map <int, int>::Node) << ' '
+              << sizeof(sjtu::map <int, int, std::less<int>, sjtu::order_statistics_policy>::Node) << '\n';
+    return 0;
+}
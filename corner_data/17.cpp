@@ -0,0 +1,53 @@
+#include "src.hpp"
+#include <iostream>
+#include <string>
+
+template <class Map>
+void dump(const Map &map) {
+    std::cout << map.size() << ':';
+    for (auto it = map.cbegin(); it != map.cend(); ++it) std::cout << ' ' << it->first << '=' << it->second;
+    std::cout << '\n';
+}
+
+signed main() {
+    sjtu::persistent_map <int, std::string> map;
+    for (int i = 0; i < 8; ++i) map[i] = std::string(1, 'a' + i);
+
+    // Copies are snapshots: writes on either side stay on that side.
+    auto before = map;
+    map[3] = "changed";
+    map.erase(5);
+    map.insert({10, "ten"});
+    before.erase(0);
+    before[1] += "!";
+    dump(map);
+    dump(before);
+
+    // A chain of snapshots, each taken after another round of writes.
+    sjtu::persistent_map <int, int> counts;
+    sjtu::persistent_map <int, int> history[5];
+    for (int round = 0; round < 5; ++round) {
+        for (int i = 0; i < 1000; ++i) counts[i * 7 % 1000] += round;
+        for (int i = round; i < 1000; i += 5) counts.erase(i);
+        history[round] = counts;
+    }
+    for (auto &h : history) {
+        long long sum = 0;
+        for (auto it = h.cbegin(); it != h.cend(); ++it) sum += it->second;
+        std::cout << h.size() << ' ' << sum << ' ' << h.begin()->first << ' ' << (--h.end())->first << '\n';
+    }
+
+    // Iterators of an old snapshot keep working while the source changes.
+    auto old = history[2];
+    auto it = old.lower_bound(500);
+    for (int i = 0; i < 1000; ++i) history[2].erase(i);
+    int walked = 0;
+    for (; it != old.cend(); ++it) ++walked;
+    std::cout << walked << ' ' << history[2].size() << ' ' << old.size() << '\n';
+
+    std::cout << old.count(502) << ' ' << old.count(500) << ' ' << old.upper_bound(502)->first << '\n';
+    try { history[2].at(1); } catch (...) { std::cout << "at\n"; }
+    old.insert_or_assign(502, -1);
+    std::cout << old.at(502) << ' ' << history[3].at(502) << '\n';
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "src.hpp"
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Writers keep two rules that readers check on every version they see: the
+// value of key k is 2k, and the pair keys 2j and 2j + 1 of the upper range
+// come and go together.
+const int WRITERS = 4, READERS = 4, PER_WRITER = 3000, PAIR_BASE = 1000000;
+
+signed main() {
+    sjtu::concurrent_map <int, int> map;
+    std::atomic<int> writers_left(WRITERS), broken(0);
+    std::atomic<long long> reads(0);
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < WRITERS; ++w) {
+        threads.emplace_back([&map, &writers_left, w] {
+            for (int i = 0; i < PER_WRITER; ++i) {
+                int key = w * PER_WRITER + i;
+                map.insert({key, 2 * key});
+                if (i % 3 == 0) map.erase(key);
+                if (i % 5 == 0) map.insert_or_assign(key, 2 * key);
+                int pair = PAIR_BASE + 2 * key;
+                map.update([pair](sjtu::concurrent_map<int, int>::snapshot_type &m) {
+                    m.insert({pair, 2 * pair});
+                    m.insert({pair + 1, 2 * (pair + 1)});
+                });
+                if (i % 4 == 0) {
+                    map.update([pair](sjtu::concurrent_map<int, int>::snapshot_type &m) {
+                        m.erase(pair);
+                        m.erase(pair + 1);
+                    });
+                }
+            }
+            --writers_left;
+        });
+    }
+    for (int r = 0; r < READERS; ++r) {
+        threads.emplace_back([&map, &writers_left, &broken, &reads, r] {
+            unsigned probe = r;
+            do {
+                for (int i = 0; i < 200; ++i) {
+                    probe = probe * 1103515245u + 12345u;
+                    int key = (probe >> 8) % (WRITERS * PER_WRITER);
+                    int value = -1;
+                    if (map.find(key, value) && value != 2 * key) ++broken;
+                    try {
+                        if (map.at(key) != 2 * key) ++broken;
+                    } catch (sjtu::index_out_of_bound &) {}
+                    reads += 2;
+                }
+                auto snap = map.snapshot();
+                int prev = -1;
+                for (auto it = snap.cbegin(); it != snap.cend(); ++it) {
+                    if (it->first <= prev || it->second != 2 * it->first) ++broken;
+                    if (it->first >= PAIR_BASE && it->first % 2 == 0 && snap.count(it->first + 1) != 1) ++broken;
+                    if (it->first >= PAIR_BASE && it->first % 2 == 1 && snap.count(it->first - 1) != 1) ++broken;
+                    prev = it->first;
+                }
+            } while (writers_left > 0);
+        });
+    }
+    for (auto &t : threads) t.join();
+    map.synchronize();
+
+    // Keys with i % 3 == 0 were erased unless i % 5 == 0 put them back; pairs
+    // with i % 4 == 0 were erased.
+    int singles = 0, pairs = 0;
+    for (int i = 0; i < PER_WRITER; ++i) {
+        singles += i % 3 != 0 || i % 5 == 0;
+        pairs += i % 4 != 0;
+    }
+    std::cout << broken << ' ' << (reads > 0) << '\n';
+    std::cout << map.size() << ' ' << WRITERS * (singles + 2 * pairs) << '\n';
+    int missing = 0;
+    for (int w = 0; w < WRITERS; ++w) {
+        for (int i = 0; i < PER_WRITER; ++i) {
+            int key = w * PER_WRITER + i, value = 0;
+            bool want = i % 3 != 0 || i % 5 == 0;
+            if (map.find(key, value) != want || (want && value != 2 * key)) ++missing;
+            if (map.count(PAIR_BASE + 2 * key) != (i % 4 != 0 ? 1u : 0u)) ++missing;
+        }
+    }
+    std::cout << missing << '\n';
+    map.clear();
+    std::cout << map.size() << ' ' << map.empty() << '\n';
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "src.hpp"
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Writers store 2k under every key k; readers check that on whatever they
+// find while shards keep splitting under them.
+const int WRITERS = 4, READERS = 3, PER_WRITER = 5000;
+
+signed main() {
+    sjtu::sharded_map <int, int> map(64);
+    std::atomic<int> writers_left(WRITERS), broken(0);
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < WRITERS; ++w) {
+        threads.emplace_back([&map, &writers_left, &broken, w] {
+            for (int i = 0; i < PER_WRITER; ++i) {
+                int key = i * WRITERS + w; // every writer touches every range
+                if (!map.insert({key, 2 * key})) ++broken;
+                if (i % 3 == 0) map.erase(key);
+                if (i % 5 == 0) map.insert_or_assign(key, 2 * key);
+                map.update(-1 - w, [](int &hits) { ++hits; });
+            }
+            --writers_left;
+        });
+    }
+    for (int r = 0; r < READERS; ++r) {
+        threads.emplace_back([&map, &writers_left, &broken, r] {
+            unsigned probe = r;
+            do {
+                probe = probe * 1103515245u + 12345u;
+                int key = (probe >> 8) % (WRITERS * PER_WRITER), value = -1;
+                if (map.find(key, value) && value != 2 * key) ++broken;
+                try {
+                    if (map.at(key) != 2 * key) ++broken;
+                } catch (sjtu::index_out_of_bound &) {}
+                if (map.count(key) > 1) ++broken;
+            } while (writers_left > 0);
+        });
+    }
+    for (auto &t : threads) t.join();
+    threads.clear();
+
+    int kept = 0;
+    for (int i = 0; i < PER_WRITER; ++i) kept += i % 3 != 0 || i % 5 == 0;
+    int wrong = 0, prev = -WRITERS - 1;
+    for (auto it = map.cbegin(); it != map.cend(); ++it) {
+        if (it->first <= prev) ++wrong;
+        if (it->first >= 0 && it->second != 2 * it->first) ++wrong;
+        if (it->first < 0 && it->second != PER_WRITER) ++wrong;
+        prev = it->first;
+    }
+    std::cout << broken << ' ' << wrong << ' ' << (map.shard_count() > 16) << '\n';
+    std::cout << map.size() << ' ' << WRITERS * (kept + 1) << '\n';
+
+    // Clearing while other threads insert and split: the halves of a split
+    // share memory, which has to survive whichever shard lets go first.
+    std::atomic<bool> done(false);
+    threads.emplace_back([&map, &done] {
+        while (!done) map.clear();
+    });
+    for (int w = 0; w < WRITERS; ++w) {
+        threads.emplace_back([&map, &broken, w] {
+            for (int i = 0; i < PER_WRITER; ++i) {
+                int key = 100000 + i * WRITERS + w, value = 0;
+                map.insert_or_assign(key, 2 * key);
+                if (map.find(key, value) && value != 2 * key) ++broken;
+            }
+        });
+    }
+    for (size_t i = 1; i < threads.size(); ++i) threads[i].join();
+    done = true;
+    threads[0].join();
+    map.clear();
+    std::cout << broken << ' ' << map.size() << ' ' << map.empty() << '\n';
+    for (int i = 0; i < 1000; ++i) map.insert({i, 2 * i});
+    std::cout << map.size() << ' ' << map.at(999) << ' ' << (map.cbegin() != map.cend()) << '\n';
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "src.hpp"
+#include <iostream>
+#include <vector>
+
+// A comparator whose direction is fixed when it is made.
+bool make_descending = false;
+struct direction {
+    bool descending;
+    direction() : descending(make_descending) {}
+    bool operator()(int a, int b) const { return descending ? b < a : a < b; }
+};
+
+unsigned next_random() {
+    static unsigned state = 12345;
+    state = state * 1103515245u + 12345u;
+    return state >> 8;
+}
+
+template <class Map>
+bool same(const Map &a, const Map &b) {
+    if (a.size() != b.size()) return false;
+    for (auto x = a.cbegin(), y = b.cbegin(); x != a.cend(); ++x, ++y) {
+        if (x->first != y->first || x->second != y->second) return false;
+    }
+    return true;
+}
+
+signed main() {
+    sjtu::thread_pool pool(4);
+    typedef sjtu::map <int, int> Map;
+    typedef sjtu::pair<const int, int> Value;
+
+    // parallel_build keeps the first of equal keys, like inserting in order.
+    std::vector<Value> input;
+    for (int i = 0; i < 200000; ++i) input.push_back(Value(next_random() % 100000, i));
+    Map built = sjtu::parallel_build<Map>(input.begin(), input.end(), pool);
+    Map expected;
+    for (size_t i = 0; i < input.size(); ++i) expected.insert(input[i]);
+    std::cout << same(built, expected) << ' ' << (built.size() == expected.size()) << '\n';
+
+    // Union and intersection against the element by element versions.
+    Map a, b;
+    for (int i = 0; i < 100000; ++i) a[next_random() % 150000] = i;
+    for (int i = 0; i < 100000; ++i) b[next_random() % 150000] = -i;
+    Map both = sjtu::parallel_union(a, b, pool), common = sjtu::parallel_intersection(a, b, pool);
+    Map both_expected = a, common_expected;
+    for (auto it = b.cbegin(); it != b.cend(); ++it) both_expected.insert(*it);
+    for (auto it = a.cbegin(); it != a.cend(); ++it) {
+        if (b.count(it->first)) common_expected.insert(*it);
+    }
+    std::cout << same(both, both_expected) << ' ' << same(common, common_expected) << ' '
+              << (common.size() > 0) << ' ' << (both.size() < a.size() + b.size()) << '\n';
+    Map none;
+    std::cout << sjtu::parallel_union(none, none, pool).size() << ' ' << sjtu::parallel_intersection(a, none, pool).size()
+              << ' ' << same(sjtu::parallel_union(a, none, pool), a) << '\n';
+
+    // parallel_for_each reaches every element once.
+    sjtu::parallel_for_each(built, [](Value &v) { v.second = v.first * 2; }, pool);
+    long long sum = 0, wanted = 0;
+    for (auto it = built.cbegin(); it != built.cend(); ++it) sum += it->second, wanted += it->first * 2LL;
+    std::cout << (sum == wanted) << '\n';
+
+    // The results are ordered by the comparator of the inputs.
+    make_descending = true;
+    direction down;
+    make_descending = false;
+    typedef sjtu::map <int, int, direction> Down;
+    Down p = sjtu::parallel_build<Down>(input.begin(), input.begin() + 20000, down, pool), q(down);
+    for (int i = 0; i < 20000; ++i) q[next_random() % 100000] = i;
+    Down u = sjtu::parallel_union(p, q, pool), n = sjtu::parallel_intersection(p, u, pool);
+    int ordered = 1, found = 1, prev = 100000;
+    for (auto it = u.cbegin(); it != u.cend(); ++it) {
+        if (it->first >= prev) ordered = 0;
+        prev = it->first;
+        if (u.count(it->first) != 1) found = 0;
+    }
+    for (int i = 0; i < 20000; ++i) found &= n.count(input[i].first) == 1;
+    std::cout << ordered << ' ' << found << ' ' << same(n, p) << ' ' << u.key_comp().descending << '\n';
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "src.hpp"
+#include <iostream>
+#include <string>
+
+typedef sjtu::map <int, std::string> text;
+
+void show(const text &map) {
+    std::cout << map.size() << ':';
+    for (auto it = map.cbegin(); it != map.cend(); ++it) std::cout << ' ' << it->first << '=' << it->second;
+    std::cout << '\n';
+}
+
+// Checks the order and the size, which split() and join() both compute.
+int broken(const text &map) {
+    size_t n = 0;
+    int prev = -1000000;
+    int wrong = 0;
+    for (auto it = map.cbegin(); it != map.cend(); ++it, ++n) {
+        wrong += it->first <= prev;
+        prev = it->first;
+    }
+    return wrong + (n != map.size());
+}
+
+signed main() {
+    text map;
+    for (int i = 0; i < 10; ++i) map[i * 10] = std::string(1, 'a' + i);
+
+    // The key itself goes to the returned map, whether it is there or not.
+    text high = map.split(50);
+    show(map);
+    show(high);
+    text higher = high.split(75);
+    show(high);
+    show(higher);
+
+    // Cutting outside the keys moves all or nothing.
+    text none = map.split(1000), all = map.split(-5);
+    std::cout << none.size() << ' ' << all.size() << ' ' << map.size() << '\n';
+    map = all.split(-5);
+    std::cout << map.size() << ' ' << all.size() << ' ' << text().split(3).size() << '\n';
+
+    // Iterators to elements that stayed are still good.
+    auto kept = map.find(20);
+    text tail = map.split(30);
+    std::cout << kept->second << ' ' << (++kept == map.end()) << '\n';
+
+    // Disjoint ranges join either way round, and other ends up empty.
+    map.join(higher);
+    higher.join(tail);
+    show(higher);
+    higher.join(map);
+    show(higher);
+    std::cout << map.size() << ' ' << tail.size() << '\n';
+
+    // Overlapping keys stay in other, like insert() would leave them.
+    text clash;
+    clash[0] = "zero";
+    clash[5] = "five";
+    clash[90] = "ninety";
+    clash[95] = "ninety-five";
+    higher.join(clash);
+    show(higher);
+    show(clash);
+
+    // Big pieces: cut at every hundredth key, then put them back out of order.
+    text big;
+    for (int i = 0; i < 5000; ++i) big[i * 3] = std::to_string(i);
+    text pieces[50];
+    for (int p = 49; p > 0; --p) pieces[p] = big.split(p * 300);
+    pieces[0] = std::move(big);
+    int wrong = 0;
+    size_t total = 0;
+    for (int p = 0; p < 50; ++p) {
+        wrong += broken(pieces[p]);
+        total += pieces[p].size();
+    }
+    for (int p = 25; p < 50; ++p) pieces[0].join(pieces[p]);
+    for (int p = 24; p > 0; --p) {
+        pieces[p].join(pieces[0]);
+        pieces[0] = std::move(pieces[p]);
+    }
+    std::cout << total << ' ' << wrong << ' ' << pieces[0].size() << ' ' << broken(pieces[0]) << ' '
+              << pieces[0].at(14997) << '\n';
+
+    // The nodes outlive the maps they were allocated by.
+    text survivor;
+    {
+        text donor;
+        for (int i = 0; i < 100; ++i) donor[i] = std::string(20, 'x');
+        survivor = donor.split(60);
+        donor.clear();
+    }
+    survivor[1000] = "new";
+    std::cout << survivor.size() << ' ' << survivor.begin()->first << ' ' << survivor.at(99).size() << '\n';
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "src.hpp"
+#include <iostream>
+#include <string>
+#include <utility>
+
+// Counts how often values are made, so moving nodes around can be seen not to touch them.
+int made = 0, alive = 0;
+struct tracked {
+    std::string text;
+    explicit tracked(const std::string &t = "") : text(t) { ++made, ++alive; }
+    tracked(const tracked &o) : text(o.text) { ++made, ++alive; }
+    ~tracked() { --alive; }
+};
+
+typedef sjtu::map <int, tracked> tmap;
+
+void show(const tmap &map) {
+    std::cout << map.size() << ':';
+    for (auto it = map.cbegin(); it != map.cend(); ++it) std::cout << ' ' << it->first << '=' << it->second.text;
+    std::cout << '\n';
+}
+
+signed main() {
+    {
+        tmap a, b;
+        for (int i = 0; i < 6; ++i) a.insert({i, tracked(std::string(1, 'a' + i))});
+        b.insert({0, tracked("b0")});
+        made = 0;
+
+        // Handles own their element; the map no longer has it.
+        tmap::node_type two = a.extract(2);
+        tmap::node_type none = a.extract(42);
+        auto after = a.find(3);
+        tmap::node_type four = a.extract(a.find(4));
+        std::cout << two.empty() << ' ' << bool(none) << ' ' << two.key() << ' ' << two.mapped().text << ' '
+                  << four.key() << ' ' << after->second.text << '\n';
+        show(a);
+
+        // Putting them into another map moves the node, not the value.
+        auto res = b.insert(std::move(two));
+        std::cout << res.inserted << ' ' << res.position->first << ' ' << res.node.empty() << ' ' << two.empty()
+                  << '\n';
+        auto at = b.insert(b.end(), std::move(four));
+        std::cout << at->first << ' ' << four.empty() << '\n';
+        auto empty = b.insert(std::move(none));
+        std::cout << empty.inserted << ' ' << (empty.position == b.end()) << '\n';
+
+        // A key that is taken leaves the element with the handle.
+        auto taken = b.insert(a.extract(0));
+        std::cout << taken.inserted << ' ' << taken.position->second.text << ' ' << taken.node.key() << ' '
+                  << taken.node.mapped().text << '\n';
+        tmap::node_type back = std::move(taken.node);
+        a.insert(a.begin(), std::move(back));
+        std::cout << back.empty() << ' ' << made << '\n';
+        show(a);
+        show(b);
+
+        // merge() leaves the keys both maps have in the source.
+        a.merge(b);
+        show(a);
+        show(b);
+        a.merge(tmap(b));
+        std::cout << a.size() << ' ' << made << '\n';
+
+        // extract() checks its iterator.
+        try {
+            a.extract(a.end());
+        } catch (sjtu::invalid_iterator &) {
+            std::cout << "end" << '\n';
+        }
+        try {
+            a.extract(b.begin());
+        } catch (sjtu::invalid_iterator &) {
+            std::cout << "foreign" << '\n';
+        }
+    }
+    std::cout << alive << '\n';
+
+    // A handle keeps its node and the memory under it after its map is gone.
+    tmap::node_type orphan;
+    {
+        tmap gone;
+        for (int i = 0; i < 100; ++i) gone.insert({i, tracked(std::string(30, 'z'))});
+        orphan = gone.extract(50);
+    }
+    std::cout << alive << ' ' << orphan.key() << ' ' << orphan.mapped().text.size() << '\n';
+    tmap home;
+    home.insert(std::move(orphan));
+    home.erase(home.begin());
+    std::cout << alive << ' ' << home.size() << '\n';
+    return 0;
+}
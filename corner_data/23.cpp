@@ -0,0 +1,65 @@
+#include "src.hpp"
+#include <functional>
+#include <iostream>
+#include <string>
+
+// A key that counts how often one is made, so lookups can be seen not to make any.
+int keys_made = 0;
+struct ticket {
+    int id;
+    ticket(int i) : id(i) { ++keys_made; }
+    ticket(const ticket &o) : id(o.id) { ++keys_made; }
+};
+
+// Orders tickets by id, and compares them with plain ints directly.
+struct by_id {
+    typedef void is_transparent;
+    bool operator()(const ticket &a, const ticket &b) const { return a.id < b.id; }
+    bool operator()(const ticket &a, int b) const { return a.id < b; }
+    bool operator()(int a, const ticket &b) const { return a < b.id; }
+};
+
+// The same order without is_transparent: lookups by int convert first.
+struct by_id_only {
+    bool operator()(const ticket &a, const ticket &b) const { return a.id < b.id; }
+};
+
+signed main() {
+    sjtu::map <ticket, int, by_id> open;
+    for (int i = 0; i < 100; i += 2) open.insert({ticket(i), i * 10});
+    keys_made = 0;
+
+    std::cout << open.find(42)->second << ' ' << (open.find(43) == open.end()) << ' ' << open.count(10) << ' '
+              << open.count(11) << '\n';
+    std::cout << open.at(8) << ' ' << *open.try_at(96) << ' ' << (open.try_at(97) == nullptr) << '\n';
+    std::cout << open.lower_bound(31)->first.id << ' ' << open.upper_bound(32)->first.id << ' '
+              << (open.lower_bound(99) == open.end()) << '\n';
+    auto range = open.equal_range(50);
+    auto miss = open.equal_range(51);
+    std::cout << range.first->first.id << ' ' << range.second->first.id << ' ' << (miss.first == miss.second)
+              << ' ' << miss.first->first.id << '\n';
+    try {
+        open.at(1);
+    } catch (sjtu::index_out_of_bound &) {
+        std::cout << "missing" << '\n';
+    }
+    const sjtu::map <ticket, int, by_id> &view = open;
+    std::cout << view.find(0)->second << ' ' << view.at(98) << ' ' << (view.try_at(-1) == nullptr) << ' '
+              << view.lower_bound(-5)->first.id << ' ' << keys_made << '\n';
+
+    // Without is_transparent every lookup by int makes a ticket first.
+    sjtu::map <ticket, int, by_id_only> closed;
+    for (int i = 0; i < 10; ++i) closed.insert({ticket(i), i});
+    keys_made = 0;
+    std::cout << closed.find(4)->second << ' ' << closed.count(20) << ' ' << closed.at(9) << ' ' << keys_made
+              << '\n';
+
+    // std::less<> looks strings up by string literal.
+    sjtu::map <std::string, int, std::less<>> words;
+    words["apple"] = 1;
+    words["banana"] = 2;
+    words["cherry"] = 3;
+    std::cout << words.count("banana") << ' ' << words.count("durian") << ' ' << words.find("cherry")->second
+              << ' ' << words.lower_bound("b")->first << ' ' << *words.try_at("apple") << '\n';
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "src.hpp"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+typedef sjtu::map <int, int> imap;
+
+// Runs f and prints the name of the sjtu exception it throws, or "none".
+template<class F>
+void expect(const char *label, F f) {
+    std::cout << label << ": ";
+    try {
+        f();
+        std::cout << "none";
+    } catch (const sjtu::exception &e) {
+        std::cout << e.what() << '[' << std::strlen(e.details()) << ']';
+    }
+    std::cout << '\n';
+}
+
+signed main() {
+    imap map;
+    for (int i = 1; i <= 5; ++i) map[i] = i * i;
+    const imap &view = map;
+
+    // try_at() is at() with a null pointer instead of the exception.
+    int *hit = map.try_at(3);
+    *hit = -9;
+    std::cout << *hit << ' ' << map.at(3) << ' ' << (map.try_at(6) == nullptr) << ' ' << *view.try_at(5) << ' '
+              << (view.try_at(0) == nullptr) << ' ' << map.size() << '\n';
+    const imap empty;
+    std::cout << (empty.try_at(1) == nullptr) << '\n';
+
+    expect("at", [&] { map.at(6); });
+    expect("const at", [&] { view.at(0); });
+    expect("const []", [&] { view[7]; });
+    expect("empty at", [&] { empty.at(0); });
+    expect("hit", [&] { view.at(1); });
+    std::cout << map.size() << '\n';
+
+    // Misused iterators.
+    imap other;
+    other[1] = 1;
+    expect("*end", [&] { *map.end(); });
+    expect("++end", [&] { ++map.end(); });
+    expect("--begin", [&] { --map.begin(); });
+    expect("erase end", [&] { map.erase(map.end()); });
+    expect("erase foreign", [&] { map.erase(other.begin()); });
+    expect("hint foreign", [&] { map.insert(other.begin(), {9, 9}); });
+    std::cout << map.size() << ' ' << other.size() << '\n';
+
+    // A stream that is not what save() wrote leaves the map alone.
+    std::istringstream junk("not a map at all, not even close to one");
+    expect("load junk", [&] { map.load(junk); });
+    std::stringstream saved;
+    map.save(saved);
+    std::string cut = saved.str();
+    std::istringstream whole(cut), truncated(cut.substr(0, cut.size() - 3));
+    other.load(whole);
+    expect("load short", [&] { map.load(truncated); });
+    std::cout << map.size() << ' ' << map.at(3) << ' ' << other.size() << ' ' << other.at(5) << '\n';
+
+    // The exceptions themselves are made, copied and thrown without allocating.
+    sjtu::invalid_iterator original;
+    sjtu::exception copy = original;
+    copy = sjtu::index_out_of_bound();
+    std::cout << noexcept(sjtu::index_out_of_bound()) << noexcept(sjtu::runtime_error())
+              << noexcept(sjtu::exception(copy)) << noexcept(copy = original) << noexcept(copy.what()) << ' '
+              << copy.what() << ' ' << original.what() << ' ' << sjtu::container_is_empty().what() << '\n';
+
+    // A detail follows the variant in what(), copies keep it, and one too
+    // long for the message is cut short.
+    sjtu::runtime_error bad("bad header");
+    sjtu::exception kept = original;
+    kept = bad;
+    std::string longer(300, 'x');
+    sjtu::invalid_iterator trimmed(longer.c_str());
+    std::cout << bad.what() << '|' << kept.what() << '|' << kept.details() << '|' << std::strlen(trimmed.what()) << ' '
+              << std::strlen(trimmed.details()) << '\n';
+    return 0;
+}
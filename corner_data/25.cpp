@@ -0,0 +1,65 @@
+#include "src.hpp"
+#include <iostream>
+#include <string>
+
+typedef sjtu::map <int, std::string> smap;
+
+// Runs f and prints whether it threw invalid_iterator.
+template<class F>
+void expect(const char *label, F f) {
+    std::cout << label << ' ';
+    try {
+        f();
+        std::cout << "ok";
+    } catch (sjtu::invalid_iterator &) {
+        std::cout << "stale";
+    }
+    std::cout << '\n';
+}
+
+signed main() {
+    smap map;
+    for (int i = 0; i < 20; ++i) map[i] = std::to_string(i * i);
+
+    // An iterator to an erased element throws on every use, until its
+    // memory holds another element again.
+    smap::iterator gone = map.find(7), kept = map.find(8);
+    smap::const_iterator cgone = gone;
+    map.erase(gone);
+    expect("*", [&] { *gone; });
+    expect("->", [&] { gone->second.size(); });
+    expect("++", [&] { ++gone; });
+    expect("--", [&] { gone--; });
+    expect("const *", [&] { *cgone; });
+    expect("erase", [&] { map.erase(gone); });
+    expect("extract", [&] { map.extract(cgone); });
+    expect("hint", [&] { map.insert(cgone, {100, "x"}); });
+    std::cout << map.size() << ' ' << map.count(100) << '\n';
+
+    // Iterators to the other elements are untouched.
+    expect("kept", [&] { std::cout << kept->second << ' ' << (++kept)->first << ' '; });
+
+    // The same after erasing by key and by range.
+    smap::iterator by_key = map.find(3), in_range = map.find(12), past_range = map.find(15);
+    map.erase(3);
+    map.erase(map.find(10), past_range);
+    expect("by key", [&] { *by_key; });
+    expect("in range", [&] { ++in_range; });
+    expect("range end", [&] { std::cout << past_range->second << ' '; });
+    std::cout << map.size() << ' ' << map.begin()->first << '\n';
+
+    // The root and the ends of the map are caught as well.
+    smap one;
+    one[1] = "one";
+    smap::iterator only = one.begin();
+    one.erase(one.begin());
+    expect("only", [&] { *only; });
+    std::cout << one.empty() << ' ' << (one.begin() == one.end()) << '\n';
+    smap::iterator first = map.begin(), last = --map.end();
+    map.erase(first);
+    map.erase(last);
+    expect("first", [&] { --first; });
+    expect("last", [&] { ++last; });
+    std::cout << map.size() << ' ' << map.begin()->first << ' ' << (--map.end())->first << '\n';
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include "src.hpp"
+#include <iostream>
+#include <string>
+
+template <class Map>
+void dump(const Map &map) {
+    std::cout << map.size() << ':';
+    for (auto it = map.cbegin(); it != map.cend(); ++it) std::cout << ' ' << it->first << '=' << it->second;
+    std::cout << '\n';
+}
+
+signed main() {
+    sjtu::flat_map <int, int> map;
+    for (int i = 0; i < 2000; ++i) map[(i * 7919) % 2000] = i;
+    std::cout << map.size() << ' ' << map.begin()->first << ' ' << (--map.end())->first << '\n';
+    for (int i = 0; i < 2000; i += 3) map.erase(i);
+    std::cout << map.size() << ' ' << map.count(3) << ' ' << map.count(4) << ' ' << map.at(1000) << '\n';
+    std::cout << map.lower_bound(3)->first << ' ' << map.upper_bound(4)->first << ' '
+              << (map.lower_bound(2000) == map.end()) << ' ' << (map.find(6) == map.end()) << '\n';
+
+    // Values are written through the iterator.
+    for (auto it = map.begin(); it != map.end(); ++it) it->second = it->first * 2;
+    (*map.find(1)).second = -1;
+    long long sum = 0;
+    for (auto it = map.cbegin(); it != map.cend(); ++it) sum += it->second;
+    std::cout << sum << '\n';
+
+    auto it = map.end();
+    int steps = 0;
+    while (it != map.begin()) --it, ++steps;
+    std::cout << steps << '\n';
+
+    // Frozen from a map, unsorted ranges and copies.
+    sjtu::map <std::string, int> tree;
+    for (int i = 0; i < 50; ++i) tree[std::to_string(i * 37 % 50)] = i;
+    sjtu::flat_map <std::string, int> frozen(tree);
+    std::cout << frozen.size() << ' ' << frozen.begin()->first << ' ' << (--frozen.end())->first << ' '
+              << frozen.at("7") << '\n';
+    int raw[] = {5, 3, 9, 3, 1, 9, 7};
+    sjtu::map <int, int> pairs;
+    sjtu::flat_map <int, int> ranged(pairs.cbegin(), pairs.cend());
+    for (int i = 0; i < 7; ++i) ranged.insert({raw[i], i});
+    std::cout << ranged.insert({3, 100}).second << ' ' << ranged.at(3) << '\n';
+    dump(ranged);
+    auto copy = ranged;
+    copy.erase(copy.begin());
+    copy[4] = 4;
+    dump(ranged);
+    dump(copy);
+
+    try { ranged.at(2); } catch (...) { std::cout << "at\n"; }
+    const sjtu::flat_map <int, int> &view = ranged;
+    try { view.at(8); } catch (...) { std::cout << "const at\n"; }
+    while (!copy.empty()) copy.erase(copy.begin());
+    std::cout << (copy.begin() == copy.end()) << '\n';
+    return 0;
+}
@@ -0,0 +1,49 @@
+#include "src.hpp"
+#include <iostream>
+#include <string>
+
+signed main() {
+    sjtu::map <int, int> tree;
+    for (int i = 0; i < 1000; ++i) tree[(i * 7919) % 3001] = i;
+    const sjtu::frozen_map <int, int> map(tree);
+    std::cout << map.size() << ' ' << map.begin()->first << ' ' << (--map.end())->first << '\n';
+    std::cout << map.count(0) << ' ' << map.count(1) << ' ' << map.at(7919 % 3001) << '\n';
+    std::cout << map.lower_bound(1)->first << ' ' << map.upper_bound(7919 % 3001)->first << ' '
+              << (map.lower_bound(3001) == map.end()) << ' ' << (map.find(1) == map.end()) << '\n';
+
+    // Iteration is in key order both ways, whatever the layout.
+    long long sum = 0;
+    int prev = -1, ordered = 1, steps = 0;
+    for (auto it = map.cbegin(); it != map.cend(); ++it) {
+        if (it->first <= prev) ordered = 0;
+        prev = it->first;
+        sum += (long long)it->first * it->second;
+    }
+    auto it = map.cend();
+    while (it != map.cbegin()) --it, ++steps;
+    std::cout << ordered << ' ' << sum << ' ' << steps << '\n';
+
+    // Every size up to a few levels, so both full and ragged last levels are walked.
+    for (int n = 0; n < 20; ++n) {
+        sjtu::map <std::string, int> small;
+        for (int i = 0; i < n; ++i) small[std::to_string(i * 13 % 20)] = i;
+        const sjtu::frozen_map <std::string, int> frozen(small);
+        std::cout << frozen.size() << ':';
+        for (auto f = frozen.cbegin(); f != frozen.cend(); ++f) std::cout << ' ' << f->first;
+        std::cout << " | " << frozen.count("13") << (frozen.lower_bound("2") == frozen.cend() ? " -" : " " + frozen.lower_bound("2")->first) << '\n';
+    }
+
+    try {
+        map.at(1);
+    } catch (...) {
+        std::cout << "at\n";
+    }
+    try {
+        sjtu::map <int, int> none;
+        const sjtu::frozen_map <int, int> empty(none);
+        std::cout << empty.size() << ' ' << (empty.cbegin() == empty.cend()) << '\n';
+    } catch (...) {
+        std::cout << "empty\n";
+    }
+    return 0;
+}
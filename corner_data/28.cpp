@@ -0,0 +1,79 @@
+#include "src.hpp"
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// A comparator whose direction is fixed when it is made.
+bool make_descending = false;
+struct direction {
+    bool descending;
+    direction() : descending(make_descending) {}
+    bool operator()(int a, int b) const { return descending ? b < a : a < b; }
+};
+
+template <class Map>
+void dump(const Map &map) {
+    std::cout << map.size() << ':';
+    for (auto it = map.cbegin(); it != map.cend(); ++it) std::cout << ' ' << it->first << '=' << it->second;
+    std::cout << '\n';
+}
+
+signed main() {
+    sjtu::map <int, double> map;
+    for (int i = 0; i < 1000; ++i) map[(i * 7919) % 1000] = i / 4.0;
+    std::stringstream file;
+    map.save(file);
+
+    // A round trip gives the same elements, whatever the target held before.
+    sjtu::map <int, double> copy;
+    for (int i = -5; i < 0; ++i) copy[i] = i;
+    copy.load(file);
+    int same = copy.size() == map.size();
+    for (auto a = map.cbegin(), b = copy.cbegin(); a != map.cend(); ++a, ++b) same &= a->first == b->first && a->second == b->second;
+    std::cout << same << ' ' << copy.count(-1) << ' ' << copy.at(7919 % 1000) << '\n';
+
+    // An empty map round trips too.
+    sjtu::map <int, double> none;
+    std::stringstream empty;
+    none.save(empty);
+    copy.load(empty);
+    std::cout << copy.size() << '\n';
+
+    // A short or foreign stream is refused and the map is left as it was.
+    copy[1] = 1.5;
+    std::string bytes = file.str();
+    std::stringstream cut(bytes.substr(0, bytes.size() - 3));
+    try {
+        copy.load(cut);
+    } catch (sjtu::runtime_error &) {
+        std::cout << "short ";
+    }
+    std::stringstream other;
+    sjtu::map <int, char> narrow;
+    narrow[1] = 'x';
+    narrow.save(other);
+    try {
+        copy.load(other);
+    } catch (sjtu::runtime_error &) {
+        std::cout << "foreign ";
+    }
+    dump(copy);
+
+    // The loaded tree is ordered by the comparator of the map it goes into.
+    make_descending = true;
+    sjtu::map <int, int, direction> down;
+    make_descending = false;
+    for (int i = 0; i < 10; ++i) down[i * 3 % 10] = i;
+    std::stringstream saved;
+    down.save(saved);
+    down[42] = 0;
+    down.load(saved);
+    dump(down);
+    int found = 0;
+    for (int i = 0; i < 10; ++i) found += down.count(i);
+    std::cout << found << ' ' << down.lower_bound(5)->first << ' ' << down.at(9) << '\n';
+    down[-1] = -1;
+    down[11] = 11;
+    dump(down);
+    return 0;
+}
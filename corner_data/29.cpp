@@ -0,0 +1,67 @@
+#include "src.hpp"
+#include <iostream>
+
+// Counts its own calls, which map::stats() has to agree with.
+long calls = 0;
+struct counting_less {
+    bool operator()(int a, int b) const {
+        ++calls;
+        return a < b;
+    }
+};
+
+typedef sjtu::map <int, int, counting_less, sjtu::collect_stats_policy> smap;
+
+void show(const sjtu::map_stats &s) {
+    std::cout << s.comparisons << ' ' << s.allocations << ' ' << s.deallocations << ' ' << s.rotations << ' '
+              << s.fix_insert_steps << ' ' << s.fix_delete_steps << ' ' << s.searches << ' ' << s.total_depth << ' '
+              << s.max_depth << ' ' << s.average_depth() << '\n';
+}
+
+signed main() {
+    // Without the policy everything stays zero.
+    sjtu::map <int, int> plain;
+    for (int i = 0; i < 100; ++i) plain[i] = i;
+    plain.find(5);
+    show(plain.stats());
+
+    // 1, 2, 3 in order: one rotation in one round of rebalancing, and
+    // descents of 0, 1 and 2 nodes that each compare twice per node.
+    smap map;
+    show(map.stats());
+    for (int i = 1; i <= 3; ++i) map[i] = i;
+    show(map.stats());
+
+    // reset_stats() works on a const map and starts over from zero.
+    const smap &view = map;
+    view.reset_stats();
+    view.find(2);
+    view.find(0);
+    show(map.stats());
+
+    // Copies count from zero, and swap() leaves the counts with their map.
+    map.reset_stats();
+    for (int i = 4; i <= 1000; ++i) map.insert({i, i});
+    smap copy = map;
+    show(copy.stats());
+    sjtu::map_stats before = map.stats();
+    smap other;
+    other[0] = 0;
+    map.swap(other);
+    std::cout << (map.stats().allocations == before.allocations) << ' ' << other.stats().allocations << ' '
+              << (before.rotations > 0) << ' ' << (before.max_depth < 20) << '\n';
+    map.swap(other);
+
+    // The comparisons counted are exactly the calls of the comparator.
+    map.reset_stats();
+    calls = 0;
+    for (int i = 0; i < 1200; i += 3) map.count(i);
+    for (int i = 1; i <= 1000; i += 2) map.erase(map.find(i));
+    map.lower_bound(500);
+    sjtu::map_stats s = map.stats();
+    std::cout << (s.comparisons == static_cast<size_t>(calls)) << ' ' << s.deallocations << ' '
+              << (s.fix_delete_steps > 0) << ' ' << s.searches << ' ' << s.allocations << '\n';
+    map.clear();
+    std::cout << map.stats().deallocations << '\n';
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "src.hpp"
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+typedef sjtu::map <int, int> imap;
+
+// Runs both batches over keys and counts where they differ from find() and count() one by one.
+int mismatches(imap &map, const std::vector<int> &keys) {
+    std::vector<imap::iterator> found;
+    std::vector<imap::const_iterator> cfound;
+    std::vector<size_t> counts(keys.size() + 1, 7);
+    const imap &view = map;
+    map.find_batch(keys.begin(), keys.end(), std::back_inserter(found));
+    view.find_batch(keys.begin(), keys.end(), std::back_inserter(cfound));
+    size_t total = view.count_batch(keys.begin(), keys.end(), counts.begin());
+    int wrong = (found.size() != keys.size()) + (cfound.size() != keys.size()) + (counts[keys.size()] != 7);
+    size_t expected = 0;
+    for (size_t i = 0; i < keys.size() && i < found.size() && i < cfound.size(); ++i) {
+        wrong += found[i] != map.find(keys[i]) || cfound[i] != view.find(keys[i]) || counts[i] != map.count(keys[i]);
+        expected += map.count(keys[i]);
+    }
+    return wrong + (total != expected);
+}
+
+signed main() {
+    imap map;
+    for (int i = 0; i < 3000; ++i) map[i * 2] = i;
+
+    // A handful of keys, with repeats and misses on both sides of the map.
+    std::vector<int> few = {10, 11, 10, -1, 5998, 5999, 10, 0, 6000, 11};
+    std::vector<size_t> counts(few.size());
+    std::cout << map.count_batch(few.begin(), few.end(), counts.begin()) << ':';
+    for (size_t c : counts) std::cout << ' ' << c;
+    std::cout << '\n';
+    std::vector<imap::iterator> found(few.size());
+    auto end = map.find_batch(few.begin(), few.end(), found.begin());
+    std::cout << (end == found.end()) << ' ' << found[0]->second << ' ' << (found[0] == found[2]) << ' '
+              << (found[1] == map.end()) << ' ' << (found[3] == map.end()) << ' ' << found[4]->second << ' '
+              << (found[8] == map.end()) << '\n';
+    // The iterators write through like those of find().
+    found[2]->second = -1;
+    std::cout << map.at(10) << '\n';
+
+    // Longer runs cross the blocks the keys are read in: shuffled, sorted,
+    // all the same key and all missing.
+    std::vector<int> shuffled, sorted, same(700, 1234), missing;
+    for (int i = 0; i < 1000; ++i) shuffled.push_back((i * 7919) % 6500 - 200);
+    for (int i = -100; i < 6100; i += 5) sorted.push_back(i);
+    for (int i = 0; i < 600; ++i) missing.push_back(i * 2 + 1);
+    std::cout << mismatches(map, shuffled) << ' ' << mismatches(map, sorted) << ' ' << mismatches(map, same) << ' '
+              << mismatches(map, missing) << '\n';
+    std::vector<size_t> flags(700);
+    std::cout << map.count_batch(same.begin(), same.end(), flags.begin()) << ' '
+              << map.count_batch(missing.begin(), missing.end(), flags.begin()) << '\n';
+
+    // No keys, and no elements to find them in.
+    imap empty;
+    std::cout << map.count_batch(few.begin(), few.begin(), counts.begin()) << ' '
+              << empty.count_batch(few.begin(), few.end(), counts.begin()) << ' ' << mismatches(empty, sorted) << '\n';
+    return 0;
+}
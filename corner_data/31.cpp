@@ -0,0 +1,67 @@
+#include "src.hpp"
+#include <iostream>
+#include <string>
+
+// Counts the values still alive, to see when deferred elements are really destroyed.
+int alive = 0;
+struct tracked {
+    std::string text;
+    tracked() : text("....................") { ++alive; }
+    tracked(const tracked &o) : text(o.text) { ++alive; }
+    ~tracked() { --alive; }
+};
+
+typedef sjtu::map <int, tracked> tmap;
+
+signed main() {
+    {
+        tmap map;
+        for (int i = 0; i < 1000; ++i) map[i];
+        std::cout << alive << '\n';
+
+        // The map is empty at once; its elements are still alive.
+        map.clear_deferred();
+        std::cout << map.size() << ' ' << map.empty() << ' ' << (map.begin() == map.end()) << ' ' << map.count(5)
+                  << ' ' << alive << ' ' << map.reclaim(0) << '\n';
+
+        // Each new element destroys a few old ones first.
+        for (int i = 0; i < 10; ++i) map[i * 7];
+        std::cout << map.size() << ' ' << alive << ' ' << map.reclaim(0) << '\n';
+
+        // reclaim(n) destroys up to n and reports how many are left.
+        std::cout << map.reclaim(100) << ' ' << alive << '\n';
+
+        // A second deferred clear queues behind the first.
+        map.clear_deferred();
+        std::cout << map.reclaim(0) << ' ' << alive << ' ' << map.size() << '\n';
+        for (int i = 0; i < 50; ++i) map[-i];
+        std::cout << map.reclaim(850) << ' ' << alive << ' ' << map.reclaim() << ' ' << alive << ' ' << map.size()
+                  << '\n';
+        std::cout << map.reclaim() << ' ' << map.at(-49).text.size() << '\n';
+
+        // clear() and the destructor take care of whatever is still waiting.
+        map.clear_deferred();
+        map.reclaim(3);
+        map.clear();
+        std::cout << alive << ' ' << map.reclaim(0) << '\n';
+        for (int i = 0; i < 500; ++i) map[i];
+        map.clear_deferred();
+        map.clear_deferred();
+        std::cout << alive << ' ' << map.reclaim(0) << '\n';
+    }
+    std::cout << alive << '\n';
+
+    // Moving a map takes its deferred elements along.
+    tmap from;
+    for (int i = 0; i < 100; ++i) from[i];
+    from.clear_deferred();
+    tmap to(std::move(from));
+    std::cout << to.reclaim(0) << ' ' << from.reclaim(0) << ' ' << to.reclaim() << ' ' << alive << '\n';
+
+    // With nothing to destroy it is a plain clear().
+    sjtu::map <int, int> ints;
+    for (int i = 0; i < 100; ++i) ints[i] = i;
+    ints.clear_deferred();
+    std::cout << ints.size() << ' ' << ints.reclaim(0) << '\n';
+    return 0;
+}
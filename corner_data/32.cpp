@@ -0,0 +1,53 @@
+#include "src.hpp"
+#include <iostream>
+#include <string>
+
+// Ordered by a alone, so {1, 2} and {1, 5} are the same key for the map.
+// Where the compiler has operator<=>, it compares b as well and disagrees.
+struct coarse {
+    int a, b;
+    bool operator<(const coarse &o) const { return a < o.a; }
+#if defined(__cpp_impl_three_way_comparison)
+    auto operator<=>(const coarse &o) const = default;
+#endif
+};
+
+// A comparator with its own three-way comparison, which lookups then use.
+struct by_length {
+    bool operator()(const std::string &x, const std::string &y) const {
+        return x.size() < y.size() || (x.size() == y.size() && x < y);
+    }
+    int compare3(const std::string &x, const std::string &y) const {
+        if (x.size() != y.size()) return x.size() < y.size() ? -1 : 1;
+        return x.compare(y);
+    }
+};
+
+signed main() {
+    sjtu::map <coarse, int> map;
+    for (int i = 0; i < 50; ++i) map[{i, i}] = i;
+    // find() and the bounds agree with operator<, whatever operator<=> says.
+    int agree = 0;
+    for (int i = 0; i < 50; ++i) {
+        coarse probe = {i, i + 100};
+        auto found = map.find(probe);
+        agree += found != map.end() && found == map.lower_bound(probe) && found->second == i;
+    }
+    std::cout << agree << ' ' << map.count({7, -1}) << '\n';
+    map[{7, -1}] = 70;
+    std::cout << map.size() << ' ' << map.at({7, 3}) << ' ' << map.find({7, 9})->first.b << '\n';
+    auto ins = map.insert({{8, 0}, 0});
+    std::cout << ins.second << ' ' << ins.first->second << '\n';
+    map.erase(map.find({9, 1}));
+    std::cout << map.size() << ' ' << map.count({9, 9}) << '\n';
+
+    sjtu::map <std::string, int, by_length> words;
+    const char *list[] = {"pear", "fig", "banana", "kiwi", "apple", "plum", "date"};
+    for (int i = 0; i < 7; ++i) words[list[i]] = i;
+    words.insert(words.end(), {"cherry", 7});
+    words.insert(words.begin(), {"fig", 8});
+    for (auto it = words.cbegin(); it != words.cend(); ++it) std::cout << it->first << '=' << it->second << ' ';
+    std::cout << '\n';
+    std::cout << words.count("kiwi") << ' ' << words.count("lime") << ' ' << words.at("plum") << '\n';
+    return 0;
+}
@@ -0,0 +1,30 @@
+#include "src.hpp"
+#include <iostream>
+#include <string>
+
+struct counted {
+    static int built;
+    int v;
+    counted(int v) : v(v) { ++built; }
+    counted(const counted &o) : v(o.v) { ++built; }
+};
+int counted::built = 0;
+
+signed main() {
+    sjtu::map <int, counted> map;
+    for (int i = 0; i < 100; ++i) map.try_emplace(i % 10, i);
+    // try_emplace never builds the mapped value for an existing key.
+    std::cout << map.size() << ' ' << map.at(3).v << '\n';
+    int before = counted::built;
+    for (int i = 0; i < 10; ++i) map.try_emplace(i, -1);
+    std::cout << counted::built - before << '\n';
+
+    sjtu::map <std::string, int> words;
+    auto res = words.insert_or_assign("a", 1);
+    std::cout << res.second << ' ' << res.first->second << '\n';
+    auto again = words.insert_or_assign("a", 2);
+    std::cout << again.second << ' ' << again.first->second << '\n';
+    words["b"] += 5;
+    words["b"] += 5;
+    std::cout << words.size() << ' ' << words["b"] << '\n';
+}
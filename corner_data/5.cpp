@@ -0,0 +1,93 @@
+#include "src.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+// Counts the calls of operator new and the blocks still allocated, to see
+// what the node pool asks the system for and when it gives it back.
+long news = 0, live = 0;
+
+void *operator new(size_t n) {
+    void *p = std::malloc(n == 0 ? 1 : n);
+    if (p == nullptr) throw std::bad_alloc();
+    ++news;
+    ++live;
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    if (p == nullptr) return;
+    --live;
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    operator delete(p);
+}
+
+void *operator new[](size_t n) {
+    return operator new(n);
+}
+
+void operator delete[](void *p) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    operator delete(p);
+}
+
+signed main() {
+    long before = live;
+    {
+        sjtu::map <int, int> map;
+        long start = news;
+        for (int i = 0; i < 1000; ++i) map[i] = i;
+        long filled = news - start;
+
+        // An erased slot is the next one handed out.
+        int *slot = &map.at(500);
+        map.erase(map.find(500));
+        map[5000] = 5000;
+        bool reused = &map.at(5000) == slot;
+
+        // Erasing keeps the memory, so refilling allocates nothing.
+        start = news;
+        long held = live;
+        for (int i = 1; i < 1000; i += 2) map.erase(map.find(i));
+        long after_erase = live - held;
+        for (int i = 1; i < 1000; i += 2) map[-i] = i;
+        long refilled = news - start;
+
+        // clear() hands every chunk back at once.
+        map.clear();
+        long after_clear = live - before;
+        start = news;
+        for (int i = 0; i < 10; ++i) map[i] = i;
+        long small = news - start;
+
+        std::cout << (filled > 0) << ' ' << (filled <= 12) << ' ' << reused << ' ' << after_erase << ' ' << refilled
+                  << ' ' << map.size() << ' ' << after_clear << ' ' << small << '\n';
+
+        // A copy has a pool of its own, and so does every map in a loop.
+        sjtu::map <int, int> big;
+        for (int i = 0; i < 1000; ++i) big[i] = -i;
+        start = news;
+        {
+            sjtu::map <int, int> copy(big);
+            copy.erase(copy.begin());
+            big[-1] = 1;
+            std::cout << (news - start <= 12) << ' ' << copy.size() << ' ' << big.size() << ' ' << copy.at(999)
+                      << '\n';
+        }
+        long held_before = live;
+        for (int round = 0; round < 100; ++round) {
+            sjtu::map <int, int> scratch;
+            for (int i = 0; i < 100; ++i) scratch[i] = round;
+        }
+        std::cout << live - held_before << '\n';
+    }
+    // Nothing is left once the maps are gone.
+    std::cout << live - before << '\n';
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include "src.hpp"
+#include <iostream>
+#include <utility>
+
+// A comparator whose direction is fixed when it is made.
+bool make_descending = false;
+struct direction {
+    bool descending;
+    direction() : descending(make_descending) {}
+    bool operator()(int a, int b) const { return descending ? b < a : a < b; }
+};
+
+sjtu::map <int, int> make(int n) {
+    sjtu::map <int, int> map;
+    for (int i = 0; i < n; ++i) map[i] = i * i;
+    return map;
+}
+
+signed main() {
+    // Moving hands the tree over and leaves the source empty but usable.
+    sjtu::map <int, int> a = make(1000);
+    sjtu::map <int, int> b(std::move(a));
+    std::cout << a.size() << ' ' << b.size() << ' ' << b.at(999) << '\n';
+    a[7] = 7;
+    std::cout << a.size() << ' ' << a.begin()->first << '\n';
+
+    a = std::move(b);
+    std::cout << a.size() << ' ' << b.size() << ' ' << (--a.end())->second << '\n';
+
+    // Swap exchanges everything, and both maps stay fully functional.
+    b = make(3);
+    a.swap(b);
+    std::cout << a.size() << ' ' << b.size() << '\n';
+    swap(a, b);
+    a.erase(a.find(0));
+    b.insert({-1, -1});
+    std::cout << a.size() << ' ' << a.begin()->first << ' ' << b.size() << ' ' << b.begin()->first << '\n';
+
+    // Maps as mapped values are moved around instead of cloned.
+    sjtu::map <int, sjtu::map <int, int>> nested;
+    for (int i = 0; i < 10; ++i) nested[i] = make(i);
+    std::cout << nested.size() << ' ' << nested[9].size() << '\n';
+
+    // Assignment brings the comparator the tree is ordered by along.
+    make_descending = true;
+    sjtu::map <int, int, direction> down;
+    make_descending = false;
+    for (int i = 0; i < 5; ++i) down[i] = i;
+    sjtu::map <int, int, direction> up, moved;
+    up = down;
+    moved = std::move(down);
+    up[5] = 5;
+    moved[-1] = -1;
+    std::cout << up.begin()->first << ' ' << up.count(2) << ' ' << moved.begin()->first << ' ' << moved.count(2) << '\n';
+}
@@ -0,0 +1,40 @@
+#include "src.hpp"
+#include <iostream>
+#include <utility>
+
+struct heavy {
+    static int copies, moves;
+    int v;
+    heavy(int v) : v(v) {}
+    heavy(const heavy &o) : v(o.v) { ++copies; }
+    heavy(heavy &&o) noexcept : v(o.v) { ++moves; }
+    bool operator < (const heavy &o) const { return v < o.v; }
+};
+int heavy::copies = 0, heavy::moves = 0;
+
+void report(const char *what) {
+    std::cout << what << ' ' << heavy::copies << ' ' << heavy::moves << '\n';
+    heavy::copies = heavy::moves = 0;
+}
+
+signed main() {
+    sjtu::map <int, heavy> map;
+    // Values are built inside the node, never copied.
+    map.emplace(1, 10);
+    report("emplace");
+    map.try_emplace(2, 20);
+    report("try_emplace");
+    map.insert({3, heavy(30)});
+    report("insert");
+    map.emplace_hint(map.end(), 4, 40);
+    report("emplace_hint");
+
+    // A refused emplace leaves the original element alone.
+    auto res = map.emplace(1, 11);
+    std::cout << res.second << ' ' << res.first->second.v << ' ' << map.size() << '\n';
+
+    sjtu::map <heavy, heavy> both;
+    both.emplace(heavy(1), heavy(2));
+    report("both");
+    std::cout << both.begin()->first.v << ' ' << both.begin()->second.v << '\n';
+}
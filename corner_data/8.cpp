@@ -0,0 +1,73 @@
+#include "src.hpp"
+#include <iostream>
+#include <utility>
+
+typedef sjtu::map <int, int> imap;
+
+// Whether begin() and --end() are the smallest and the largest key, found the slow way.
+bool ends_right(const imap &map) {
+    if (map.empty()) return map.cbegin() == map.cend();
+    int lo = map.cbegin()->first, hi = lo;
+    size_t n = 0;
+    for (auto it = map.cbegin(); it != map.cend(); ++it, ++n) {
+        if (it->first < lo) lo = it->first;
+        if (it->first > hi) hi = it->first;
+    }
+    size_t back = 0;
+    for (auto it = map.cend(); it != map.cbegin(); --it) ++back;
+    return n == map.size() && back == n && map.cbegin()->first == lo && (--map.cend())->first == hi;
+}
+
+signed main() {
+    imap map;
+    imap::iterator end = map.end();
+    std::cout << (map.begin() == map.end()) << ' ' << (map.cbegin() == map.cend()) << ' ' << ends_right(map) << '\n';
+
+    // Every insertion may move either end; end() itself never moves.
+    int wrong = 0;
+    for (int i = 0; i < 200; ++i) {
+        map[(i * 73) % 200 - 100] = i;
+        wrong += !ends_right(map);
+    }
+    std::cout << wrong << ' ' << (end == map.end()) << ' ' << (--end)->first << ' ' << map.begin()->first << '\n';
+
+    // Erasing the extremes moves begin() and --end() inwards.
+    wrong = 0;
+    for (int i = 0; i < 60; ++i) {
+        map.erase(map.begin());
+        map.erase(--map.end());
+        wrong += !ends_right(map) || map.begin()->first != -100 + i + 1 || (--map.end())->first != 99 - i - 1;
+    }
+    std::cout << wrong << ' ' << map.size() << ' ' << map.begin()->first << ' ' << (--map.end())->first << '\n';
+
+    // Down to a single element, whose node is both ends, and to none.
+    while (map.size() > 1) map.erase(map.begin());
+    imap::iterator only = map.begin();
+    std::cout << (only == --map.end()) << ' ' << (++only == map.end()) << ' ' << map.begin()->first << '\n';
+    map.erase(map.begin());
+    std::cout << (map.begin() == map.end()) << ' ' << ends_right(map) << '\n';
+
+    // Copies, moves and clear() set up their own ends.
+    for (int i = 0; i < 50; ++i) map[i * 3] = i;
+    imap copy = map;
+    imap moved = std::move(copy);
+    map.erase(map.begin());
+    std::cout << ends_right(map) << ' ' << ends_right(copy) << ' ' << ends_right(moved) << ' ' << moved.begin()->first
+              << ' ' << (--moved.end())->first << ' ' << map.begin()->first << '\n';
+    moved.clear();
+    moved[7] = 7;
+    std::cout << (moved.begin() == --moved.end()) << ' ' << (copy.begin() == copy.end()) << '\n';
+
+    // Stepping past either end is still an error.
+    try {
+        --map.begin();
+    } catch (sjtu::invalid_iterator &) {
+        std::cout << "before begin" << '\n';
+    }
+    try {
+        ++map.end();
+    } catch (sjtu::invalid_iterator &) {
+        std::cout << "after end" << '\n';
+    }
+    return 0;
+}
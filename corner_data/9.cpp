@@ -0,0 +1,74 @@
+#include "src.hpp"
+#include <iostream>
+
+// Counts the values alive, and throws from its copy once a countdown runs out.
+int alive = 0, copies_left = -1;
+struct fragile {
+    int v;
+    fragile(int x = 0) : v(x) { ++alive; }
+    fragile(const fragile &o) : v(o.v) {
+        if (copies_left == 0) throw 42;
+        if (copies_left > 0) --copies_left;
+        ++alive;
+    }
+    ~fragile() { --alive; }
+};
+
+signed main() {
+    const int N = 1000000;
+    {
+        // A million elements are copied and destroyed without recursion.
+        sjtu::map <int, int> big;
+        for (int i = 0; i < N; ++i) big.insert({i, i ^ 0x5555});
+        sjtu::map <int, int> copy(big);
+        long long sum = 0;
+        int wrong = 0, expect = 0;
+        for (auto it = copy.cbegin(); it != copy.cend(); ++it, ++expect) {
+            wrong += it->first != expect || it->second != (expect ^ 0x5555);
+            sum += it->second;
+        }
+        std::cout << copy.size() << ' ' << wrong << ' ' << sum << '\n';
+
+        // The copy is a tree of its own.
+        copy.erase(copy.find(0));
+        copy[-1] = -1;
+        big[N] = N;
+        std::cout << big.size() << ' ' << copy.size() << ' ' << big.begin()->first << ' ' << copy.begin()->first << ' '
+                  << (--big.end())->first << ' ' << (--copy.end())->first << '\n';
+
+        sjtu::map <int, int> assigned;
+        assigned[5] = 5;
+        assigned = copy;
+        copy.clear();
+        std::cout << assigned.size() << ' ' << assigned.at(N / 2) << ' ' << copy.size() << '\n';
+    }
+
+    // A copy that throws halfway leaves nothing behind.
+    {
+        sjtu::map <int, fragile> source;
+        for (int i = 0; i < 1000; ++i) source.insert({i, fragile(i)});
+        int before = alive;
+        copies_left = 700;
+        try {
+            sjtu::map <int, fragile> copy(source);
+            std::cout << "copied" << '\n';
+        } catch (int) {
+            std::cout << "thrown " << alive - before << '\n';
+        }
+        copies_left = -1;
+        sjtu::map <int, fragile> target;
+        target.insert({1, fragile(1)});
+        copies_left = 300;
+        try {
+            target = source;
+        } catch (int) {
+            std::cout << "thrown " << alive - before << ' ' << target.size() << ' ' << (target.begin() == target.end())
+                      << '\n';
+        }
+        copies_left = -1;
+        target = source;
+        std::cout << target.size() << ' ' << target.at(999).v << ' ' << alive - before << '\n';
+    }
+    std::cout << alive << '\n';
+    return 0;
+}
@@ -1,9 +1,9 @@
 #pragma once
-#include <map>
-
-namespace sjtu {
-
-template<class T1, class T2, class Cmp = std::less<T1>>
-using map = ::std::map<T1, T2, Cmp>;
-
-} // namespace sjtu
+#include "../src/map.hpp"
+#include "../src/btree_map.hpp"
+#include "../src/persistent_map.hpp"
+#include "../src/flat_map.hpp"
+#include "../src/frozen_map.hpp"
+#include "../src/concurrent_map.hpp"
+#include "../src/sharded_map.hpp"
+#include "../src/parallel.hpp"
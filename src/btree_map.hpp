@@ -0,0 +1,1206 @@
+/**
+* a B+ tree with the interface of sjtu::map
+*/
+#ifndef SJTU_BTREE_MAP_HPP
+#define SJTU_BTREE_MAP_HPP
+
+#include <functional>
+#include <type_traits>
+#include <cstddef>
+#include "utility.hpp"
+#include "exceptions.hpp"
+
+// In-node search for arithmetic keys is vectorised where the target allows it;
+// define SJTU_BTREE_NO_SIMD to force the scalar code.
+#ifndef SJTU_BTREE_NO_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_2__)
+#include <nmmintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace sjtu {
+
+namespace detail {
+
+// Whether nodes of a btree_map<Key, ..., Compare> are searched by counting
+// instead of by binary search over comp(). Only comparators whose meaning is
+// known qualify: a user-defined operator< may order keys any way it likes.
+template<class Key, class Compare>
+struct counted_search {
+   static const bool value = false;
+   static const bool greater = false;
+};
+
+template<class Key>
+struct counted_search<Key, std::less<Key> > {
+   static const bool value = std::is_arithmetic<Key>::value && !std::is_same<Key, bool>::value;
+   static const bool greater = false;
+};
+
+template<class Key>
+struct counted_search<Key, std::greater<Key> > {
+   static const bool value = std::is_arithmetic<Key>::value && !std::is_same<Key, bool>::value;
+   static const bool greater = true;
+};
+
+enum lane_kind_t { LANE_NONE, LANE_S32, LANE_U32, LANE_S64, LANE_U64, LANE_F32, LANE_F64 };
+
+template<class Key>
+struct lane_kind {
+   static const int value = std::is_floating_point<Key>::value
+                            ? (sizeof(Key) == 4 ? LANE_F32 : sizeof(Key) == 8 ? LANE_F64 : LANE_NONE)
+                            : sizeof(Key) == 4 ? (std::is_signed<Key>::value ? LANE_S32 : LANE_U32)
+                            : sizeof(Key) == 8 ? (std::is_signed<Key>::value ? LANE_S64 : LANE_U64)
+                            : LANE_NONE;
+};
+
+// The number of keys in [keys + i, keys + n) ordered before key, that is with
+// keys[j] < key (keys[j] > key if Greater). Branch free, so the loop costs
+// the same whichever way the comparisons go.
+template<bool Greater, class Key>
+inline size_t count_before_scalar(const Key *keys, size_t i, size_t n, Key key) {
+   size_t c = 0;
+   for (; i < n; ++i) c += Greater ? (key < keys[i]) : (keys[i] < key);
+   return c;
+}
+
+// Counting kernels, specialised below per lane type where the target has
+// vector compares for it; everything else stays scalar.
+template<class Key, bool Greater, int Kind = lane_kind<Key>::value>
+struct lane_count {
+   static size_t before(const Key *keys, size_t n, Key key) {
+       return count_before_scalar<Greater>(keys, 0, n, key);
+   }
+};
+
+#if !defined(SJTU_BTREE_NO_SIMD) && defined(__SSE2__)
+
+// Unsigned lanes are compared as signed after flipping the sign bit.
+template<class Key, bool Greater, bool Unsigned>
+inline size_t count_before_epi32(const Key *keys, size_t n, Key key) {
+   size_t i = 0, c = 0;
+   const int bias = Unsigned ? static_cast<int>(0x80000000u) : 0;
+   const int k = static_cast<int>(key) ^ bias;
+#if defined(__AVX2__)
+   const __m256i bias8 = _mm256_set1_epi32(bias), key8 = _mm256_set1_epi32(k);
+   for (; i + 8 <= n; i += 8) {
+       __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i)), bias8);
+       __m256i m = Greater ? _mm256_cmpgt_epi32(v, key8) : _mm256_cmpgt_epi32(key8, v);
+       c += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+   }
+#endif
+   const __m128i bias4 = _mm_set1_epi32(bias), key4 = _mm_set1_epi32(k);
+   for (; i + 4 <= n; i += 4) {
+       __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i)), bias4);
+       __m128i m = Greater ? _mm_cmpgt_epi32(v, key4) : _mm_cmplt_epi32(v, key4);
+       c += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(m)));
+   }
+   return c + count_before_scalar<Greater>(keys, i, n, key);
+}
+
+template<class Key, bool Greater>
+struct lane_count<Key, Greater, LANE_S32> {
+   static size_t before(const Key *keys, size_t n, Key key) {
+       return count_before_epi32<Key, Greater, false>(keys, n, key);
+   }
+};
+
+template<class Key, bool Greater>
+struct lane_count<Key, Greater, LANE_U32> {
+   static size_t before(const Key *keys, size_t n, Key key) {
+       return count_before_epi32<Key, Greater, true>(keys, n, key);
+   }
+};
+
+#if defined(__SSE4_2__) || defined(__AVX2__)
+template<class Key, bool Greater, bool Unsigned>
+inline size_t count_before_epi64(const Key *keys, size_t n, Key key) {
+   size_t i = 0, c = 0;
+   const long long bias = Unsigned ? static_cast<long long>(0x8000000000000000ull) : 0;
+   const long long k = static_cast<long long>(key) ^ bias;
+#if defined(__AVX2__)
+   const __m256i bias4 = _mm256_set1_epi64x(bias), key4 = _mm256_set1_epi64x(k);
+   for (; i + 4 <= n; i += 4) {
+       __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + i)), bias4);
+       __m256i m = Greater ? _mm256_cmpgt_epi64(v, key4) : _mm256_cmpgt_epi64(key4, v);
+       c += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+   }
+#endif
+   const __m128i bias2 = _mm_set1_epi64x(bias), key2 = _mm_set1_epi64x(k);
+   for (; i + 2 <= n; i += 2) {
+       __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + i)), bias2);
+       __m128i m = Greater ? _mm_cmpgt_epi64(v, key2) : _mm_cmpgt_epi64(key2, v);
+       c += __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(m)));
+   }
+   return c + count_before_scalar<Greater>(keys, i, n, key);
+}
+
+template<class Key, bool Greater>
+struct lane_count<Key, Greater, LANE_S64> {
+   static size_t before(const Key *keys, size_t n, Key key) {
+       return count_before_epi64<Key, Greater, false>(keys, n, key);
+   }
+};
+
+template<class Key, bool Greater>
+struct lane_count<Key, Greater, LANE_U64> {
+   static size_t before(const Key *keys, size_t n, Key key) {
+       return count_before_epi64<Key, Greater, true>(keys, n, key);
+   }
+};
+#endif
+
+template<class Key, bool Greater>
+struct lane_count<Key, Greater, LANE_F32> {
+   static size_t before(const Key *keys, size_t n, Key key) {
+       size_t i = 0, c = 0;
+       const __m128 k = _mm_set1_ps(key);
+       for (; i + 4 <= n; i += 4) {
+           __m128 v = _mm_loadu_ps(reinterpret_cast<const float *>(keys + i));
+           c += __builtin_popcount(_mm_movemask_ps(Greater ? _mm_cmpgt_ps(v, k) : _mm_cmplt_ps(v, k)));
+       }
+       return c + count_before_scalar<Greater>(keys, i, n, key);
+   }
+};
+
+template<class Key, bool Greater>
+struct lane_count<Key, Greater, LANE_F64> {
+   static size_t before(const Key *keys, size_t n, Key key) {
+       size_t i = 0, c = 0;
+       const __m128d k = _mm_set1_pd(key);
+       for (; i + 2 <= n; i += 2) {
+           __m128d v = _mm_loadu_pd(reinterpret_cast<const double *>(keys + i));
+           c += __builtin_popcount(_mm_movemask_pd(Greater ? _mm_cmpgt_pd(v, k) : _mm_cmplt_pd(v, k)));
+       }
+       return c + count_before_scalar<Greater>(keys, i, n, key);
+   }
+};
+
+#elif !defined(SJTU_BTREE_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+
+// NEON compares give all-ones lanes; subtracting them counts the matches.
+#define SJTU_BTREE_NEON_KERNEL(KIND, LANES, ELEM, VEC, LOAD, DUP, LT, GT, ACC, ZERO, SUB, SUM) \
+template<class Key, bool Greater> \
+struct lane_count<Key, Greater, KIND> { \
+   static size_t before(const Key *keys, size_t n, Key key) { \
+       size_t i = 0; \
+       const VEC k = DUP(static_cast<ELEM>(key)); \
+       ACC acc = ZERO(0); \
+       for (; i + LANES <= n; i += LANES) { \
+           VEC v = LOAD(reinterpret_cast<const ELEM *>(keys + i)); \
+           acc = SUB(acc, Greater ? GT(v, k) : LT(v, k)); \
+       } \
+       return static_cast<size_t>(SUM(acc)) + count_before_scalar<Greater>(keys, i, n, key); \
+   } \
+};
+
+SJTU_BTREE_NEON_KERNEL(LANE_S32, 4, int32_t, int32x4_t, vld1q_s32, vdupq_n_s32, vcltq_s32, vcgtq_s32,
+                       uint32x4_t, vdupq_n_u32, vsubq_u32, vaddvq_u32)
+SJTU_BTREE_NEON_KERNEL(LANE_U32, 4, uint32_t, uint32x4_t, vld1q_u32, vdupq_n_u32, vcltq_u32, vcgtq_u32,
+                       uint32x4_t, vdupq_n_u32, vsubq_u32, vaddvq_u32)
+SJTU_BTREE_NEON_KERNEL(LANE_F32, 4, float, float32x4_t, vld1q_f32, vdupq_n_f32, vcltq_f32, vcgtq_f32,
+                       uint32x4_t, vdupq_n_u32, vsubq_u32, vaddvq_u32)
+SJTU_BTREE_NEON_KERNEL(LANE_S64, 2, int64_t, int64x2_t, vld1q_s64, vdupq_n_s64, vcltq_s64, vcgtq_s64,
+                       uint64x2_t, vdupq_n_u64, vsubq_u64, vaddvq_u64)
+SJTU_BTREE_NEON_KERNEL(LANE_U64, 2, uint64_t, uint64x2_t, vld1q_u64, vdupq_n_u64, vcltq_u64, vcgtq_u64,
+                       uint64x2_t, vdupq_n_u64, vsubq_u64, vaddvq_u64)
+SJTU_BTREE_NEON_KERNEL(LANE_F64, 2, double, float64x2_t, vld1q_f64, vdupq_n_f64, vcltq_f64, vcgtq_f64,
+                       uint64x2_t, vdupq_n_u64, vsubq_u64, vaddvq_u64)
+
+#undef SJTU_BTREE_NEON_KERNEL
+
+#endif
+
+// Contiguous copies of a leaf's keys, kept only when leaves are searched by
+// counting; the keys inside value_type are strided by sizeof(T).
+template<class Key, size_t N, bool Kept>
+struct leaf_keys {
+   void keep(size_t, const Key &) {}
+   const Key *kept() const { return nullptr; }
+};
+
+template<class Key, size_t N>
+struct leaf_keys<Key, N, true> {
+   Key keys[N];
+
+   void keep(size_t i, const Key &key) { keys[i] = key; }
+   const Key *kept() const { return keys; }
+};
+
+}
+
+/**
+* drop-in alternative to sjtu::map for large maps of small keys.
+*
+* elements live in leaves of a few cache lines each and inner nodes only hold
+*   separator keys and child pointers, so a lookup touches a handful of nodes
+*   instead of one node per tree level.
+*
+* the interface and the exceptions are the ones of sjtu::map, with one
+*   difference: insert and erase shift elements inside their leaf, so they
+*   invalidate iterators (like std::vector does; sjtu::map never does).
+*   Key must be copy constructible, separators are copies of keys.
+*/
+template<
+   class Key,
+   class T,
+   class Compare = std::less <Key>
+   > class btree_map {
+public:
+   typedef pair<const Key, T> value_type;
+
+private:
+   // Target size of a node; capacities are derived from it and clamped so that
+   // splitting and merging always have room to work with.
+   static const size_t NODE_BYTES = 256;
+   static const bool COUNTED = detail::counted_search<Key, Compare>::value;
+   static const size_t LEAF_FIT = NODE_BYTES / (sizeof(value_type) + (COUNTED ? sizeof(Key) : 0));
+   static const size_t INNER_FIT = NODE_BYTES / (sizeof(Key) + sizeof(void *));
+   static const size_t LEAF_CAP = LEAF_FIT < 4 ? 4 : (LEAF_FIT > 64 ? 64 : LEAF_FIT);
+   static const size_t INNER_CAP = INNER_FIT < 4 ? 4 : (INNER_FIT > 64 ? 64 : INNER_FIT);
+   static const size_t LEAF_MIN = LEAF_CAP / 2;
+   static const size_t INNER_MIN = INNER_CAP / 2;
+
+   struct NodeBase {
+       unsigned count; // elements in a leaf, separator keys in an inner node
+       bool leaf;
+
+       explicit NodeBase(bool is_leaf) : count(0), leaf(is_leaf) {}
+   };
+
+   // Slots are raw storage: neither Key nor T needs a default constructor.
+   // Slots only change through the members below, which keep the copies of
+   // the keys (if any) in step.
+   struct Leaf : NodeBase, detail::leaf_keys<Key, LEAF_CAP, COUNTED> {
+       Leaf *prev, *next;
+       alignas(value_type) unsigned char storage[LEAF_CAP * sizeof(value_type)];
+
+       Leaf() : NodeBase(true), prev(nullptr), next(nullptr) {}
+
+       // Call after constructing slot i in place.
+       void built(size_t i) {
+           this->keep(i, slot(i)->first);
+       }
+
+       // Relocates slot j of from into the raw slot i.
+       void moveIn(size_t i, Leaf *from, size_t j) {
+           relocate(slot(i), from->slot(j));
+           built(i);
+       }
+
+       // Opens a hole at pos, relocating [pos, count) one slot up.
+       void openAt(size_t pos) {
+           for (size_t i = this->count; i > pos; --i) moveIn(i, this, i - 1);
+       }
+
+       // Closes the hole at pos; count still includes it.
+       void closeAt(size_t pos) {
+           for (size_t i = pos; i + 1 < this->count; ++i) moveIn(i, this, i + 1);
+       }
+
+       value_type *slot(size_t i) {
+           return reinterpret_cast<value_type *>(storage) + i;
+       }
+
+       const value_type *slot(size_t i) const {
+           return reinterpret_cast<const value_type *>(storage) + i;
+       }
+
+       const Key &key(size_t i) const {
+           return slot(i)->first;
+       }
+   };
+
+   // Child i holds the keys in [key(i - 1), key(i)).
+   struct Inner : NodeBase {
+       alignas(Key) unsigned char storage[INNER_CAP * sizeof(Key)];
+       NodeBase *child[INNER_CAP + 1];
+
+       Inner() : NodeBase(false) {}
+
+       Key *key(size_t i) {
+           return reinterpret_cast<Key *>(storage) + i;
+       }
+
+       const Key *key(size_t i) const {
+           return reinterpret_cast<const Key *>(storage) + i;
+       }
+   };
+
+   NodeBase *root;
+   Leaf *head, *tail; // first and last leaf, for begin() and --end()
+   size_t map_size;
+   Compare comp;
+
+   // Moves the object at from into the raw slot to and ends the lifetime of from.
+   template<class U>
+   static void relocate(U *to, U *from) {
+       new (to) U(std::move(*from));
+       from->~U();
+   }
+
+   // Opens a hole at pos in [first, first + n) by relocating the tail one slot up.
+   template<class U>
+   static void shiftUp(U *first, size_t pos, size_t n) {
+       for (size_t i = n; i > pos; --i) relocate(first + i, first + i - 1);
+   }
+
+   // Closes the hole at pos in [first, first + n), n counting the hole.
+   template<class U>
+   static void shiftDown(U *first, size_t pos, size_t n) {
+       for (size_t i = pos; i + 1 < n; ++i) relocate(first + i, first + i + 1);
+   }
+
+   typedef std::integral_constant<bool, COUNTED> counted_tag;
+
+   // Sorted keys ordered before key are exactly the ones a search skips, so
+   // counting them gives the lower bound. No branches depend on the data, and
+   // the count vectorises; only for comparators of known meaning.
+   static size_t countLower(const Key *keys, size_t n, const Key &key) {
+       return detail::lane_count<Key, detail::counted_search<Key, Compare>::greater>::before(keys, n, key);
+   }
+
+   static size_t countUpper(const Key *keys, size_t n, const Key &key) {
+       return n - detail::lane_count<Key, !detail::counted_search<Key, Compare>::greater>::before(keys, n, key);
+   }
+
+   // Binary search over the keys of a node, for any comparator. Get(x, i)
+   // is the i-th key of x.
+   template<class Node, class Get>
+   size_t searchLower(const Node *x, const Key &key, Get get) const {
+       size_t lo = 0, hi = x->count;
+       while (lo < hi) {
+           size_t mid = (lo + hi) / 2;
+           if (comp(get(x, mid), key)) {
+               lo = mid + 1;
+           } else {
+               hi = mid;
+           }
+       }
+       return lo;
+   }
+
+   template<class Node, class Get>
+   size_t searchUpper(const Node *x, const Key &key, Get get) const {
+       size_t lo = 0, hi = x->count;
+       while (lo < hi) {
+           size_t mid = (lo + hi) / 2;
+           if (comp(key, get(x, mid))) {
+               hi = mid;
+           } else {
+               lo = mid + 1;
+           }
+       }
+       return lo;
+   }
+
+   static const Key &leafKey(const Leaf *x, size_t i) {
+       return x->key(i);
+   }
+
+   static const Key &innerKey(const Inner *x, size_t i) {
+       return *x->key(i);
+   }
+
+   size_t leafLower(const Leaf *x, const Key &key, std::true_type) const {
+       return countLower(x->kept(), x->count, key);
+   }
+
+   size_t leafLower(const Leaf *x, const Key &key, std::false_type) const {
+       return searchLower(x, key, leafKey);
+   }
+
+   size_t leafUpper(const Leaf *x, const Key &key, std::true_type) const {
+       return countUpper(x->kept(), x->count, key);
+   }
+
+   size_t leafUpper(const Leaf *x, const Key &key, std::false_type) const {
+       return searchUpper(x, key, leafKey);
+   }
+
+   size_t childIndex(const Inner *x, const Key &key, std::true_type) const {
+       return countUpper(x->key(0), x->count, key);
+   }
+
+   size_t childIndex(const Inner *x, const Key &key, std::false_type) const {
+       return searchUpper(x, key, innerKey);
+   }
+
+   // Index of the first element whose key is not less than key.
+   size_t leafLower(const Leaf *x, const Key &key) const {
+       return leafLower(x, key, counted_tag());
+   }
+
+   // Index of the first element whose key is greater than key.
+   size_t leafUpper(const Leaf *x, const Key &key) const {
+       return leafUpper(x, key, counted_tag());
+   }
+
+   // The child of x that may contain key: the number of separators <= key.
+   size_t childIndex(const Inner *x, const Key &key) const {
+       return childIndex(x, key, counted_tag());
+   }
+
+   const Leaf *findLeaf(const Key &key) const {
+       const NodeBase *x = root;
+       while (!x->leaf) {
+           const Inner *inner = static_cast<const Inner *>(x);
+           x = inner->child[childIndex(inner, key)];
+       }
+       return static_cast<const Leaf *>(x);
+   }
+
+   // Element with key, as a (leaf, index) position; leaf is nullptr if absent.
+   void findPos(const Key &key, Leaf *&leaf, size_t &index) const {
+       leaf = nullptr;
+       index = 0;
+       if (root == nullptr) return;
+       const Leaf *x = findLeaf(key);
+       size_t i = leafLower(x, key);
+       if (i < x->count && !comp(key, x->key(i))) {
+           leaf = const_cast<Leaf *>(x);
+           index = i;
+       }
+   }
+
+   // Normalises a (leaf, index) position that may sit one past a leaf.
+   static void settle(Leaf *&leaf, size_t &index) {
+       if (leaf != nullptr && index == leaf->count) {
+           leaf = leaf->next;
+           index = 0;
+       }
+   }
+
+   void lowerPos(const Key &key, Leaf *&leaf, size_t &index) const {
+       leaf = nullptr;
+       index = 0;
+       if (root == nullptr) return;
+       leaf = const_cast<Leaf *>(findLeaf(key));
+       index = leafLower(leaf, key);
+       settle(leaf, index);
+   }
+
+   void upperPos(const Key &key, Leaf *&leaf, size_t &index) const {
+       leaf = nullptr;
+       index = 0;
+       if (root == nullptr) return;
+       leaf = const_cast<Leaf *>(findLeaf(key));
+       index = leafUpper(leaf, key);
+       settle(leaf, index);
+   }
+
+   // Builders for the element of a successful insertion.
+   struct CopyValue {
+       const value_type &value;
+       void operator()(void *p) const { new (p) value_type(value); }
+   };
+
+   struct MoveValue {
+       value_type &value;
+       void operator()(void *p) const { new (p) value_type(std::move(value)); }
+   };
+
+   struct DefaultValue {
+       const Key &key;
+       void operator()(void *p) const { new (p) value_type(key, T()); }
+   };
+
+   // Puts a new element at pos of a leaf with room for it.
+   template<class Make>
+   static void leafInsertAt(Leaf *x, size_t pos, const Make &make) {
+       x->openAt(pos);
+       try {
+           make(x->slot(pos));
+       } catch (...) {
+           x->count++;
+           x->closeAt(pos);
+           x->count--;
+           throw;
+       }
+       x->built(pos);
+       x->count++;
+   }
+
+   bool full(const NodeBase *x) const {
+       return x->count == (x->leaf ? LEAF_CAP : INNER_CAP);
+   }
+
+   // Splits the full child i of p, which has room for one more separator.
+   void splitChild(Inner *p, size_t i) {
+       NodeBase *c = p->child[i];
+       if (c->leaf) {
+           Leaf *x = static_cast<Leaf *>(c);
+           size_t mid = LEAF_CAP / 2;
+           Leaf *right = new Leaf;
+           // the separator is copied first: it is the only step that may throw
+           shiftUp(p->key(0), i, p->count);
+           try {
+               new (p->key(i)) Key(x->key(mid));
+           } catch (...) {
+               shiftDown(p->key(0), i, p->count + 1);
+               delete right;
+               throw;
+           }
+           for (size_t j = mid; j < LEAF_CAP; ++j) right->moveIn(j - mid, x, j);
+           right->count = static_cast<unsigned>(LEAF_CAP - mid);
+           x->count = static_cast<unsigned>(mid);
+           right->next = x->next;
+           right->prev = x;
+           if (x->next != nullptr) x->next->prev = right; else tail = right;
+           x->next = right;
+           linkAfter(p, i, right);
+           return;
+       }
+
+       Inner *x = static_cast<Inner *>(c);
+       size_t mid = INNER_CAP / 2;
+       Inner *right = new Inner;
+       for (size_t j = mid + 1; j < INNER_CAP; ++j) relocate(right->key(j - mid - 1), x->key(j));
+       for (size_t j = mid + 1; j <= INNER_CAP; ++j) right->child[j - mid - 1] = x->child[j];
+       right->count = static_cast<unsigned>(INNER_CAP - mid - 1);
+       shiftUp(p->key(0), i, p->count);
+       relocate(p->key(i), x->key(mid));
+       x->count = static_cast<unsigned>(mid);
+       linkAfter(p, i, right);
+   }
+
+   // Hangs right behind child i of p, whose separator i is already in place.
+   static void linkAfter(Inner *p, size_t i, NodeBase *right) {
+       for (size_t j = p->count + 1; j > i + 1; --j) p->child[j] = p->child[j - 1];
+       p->child[i + 1] = right;
+       p->count++;
+   }
+
+   // Top-down insertion: full nodes are split on the way down, so the element
+   // is built only once the tree is complete again and a throwing constructor
+   // leaves nothing half done. A full leaf that already holds key is left alone.
+   template<class Make>
+   pair<Leaf *, size_t> insertKey(const Key &key, const Make &make, bool &inserted) {
+       inserted = false;
+       if (root == nullptr) {
+           Leaf *x = new Leaf;
+           try {
+               make(x->slot(0));
+           } catch (...) {
+               delete x;
+               throw;
+           }
+           x->built(0);
+           x->count = 1;
+           root = head = tail = x;
+           map_size = 1;
+           inserted = true;
+           return pair<Leaf *, size_t>(x, 0);
+       }
+
+       if (full(root) && !(root->leaf && contains(static_cast<Leaf *>(root), key))) {
+           Inner *top = new Inner;
+           top->child[0] = root;
+           root = top;
+           try {
+               splitChild(top, 0);
+           } catch (...) {
+               root = top->child[0];
+               delete top;
+               throw;
+           }
+       }
+       NodeBase *node = root;
+       while (!node->leaf) {
+           Inner *x = static_cast<Inner *>(node);
+           size_t i = childIndex(x, key);
+           NodeBase *c = x->child[i];
+           if (full(c) && !(c->leaf && contains(static_cast<Leaf *>(c), key))) {
+               splitChild(x, i);
+               if (!comp(key, *x->key(i))) ++i;
+           }
+           node = x->child[i];
+       }
+
+       Leaf *x = static_cast<Leaf *>(node);
+       size_t pos = leafLower(x, key);
+       if (pos < x->count && !comp(key, x->key(pos))) return pair<Leaf *, size_t>(x, pos);
+       leafInsertAt(x, pos, make);
+       map_size++;
+       inserted = true;
+       return pair<Leaf *, size_t>(x, pos);
+   }
+
+   bool contains(const Leaf *x, const Key &key) const {
+       size_t pos = leafLower(x, key);
+       return pos < x->count && !comp(key, x->key(pos));
+   }
+
+   // Removes key from below node. Afterwards node may hold fewer than the
+   // minimum number of entries; the caller repairs that.
+   bool eraseBelow(NodeBase *node, const Key &key) {
+       if (node->leaf) {
+           Leaf *x = static_cast<Leaf *>(node);
+           size_t pos = leafLower(x, key);
+           if (pos == x->count || comp(key, x->key(pos))) return false;
+           x->slot(pos)->~value_type();
+           x->closeAt(pos);
+           x->count--;
+           return true;
+       }
+       Inner *x = static_cast<Inner *>(node);
+       size_t i = childIndex(x, key);
+       if (!eraseBelow(x->child[i], key)) return false;
+       NodeBase *c = x->child[i];
+       if (c->count < (c->leaf ? LEAF_MIN : INNER_MIN)) rebalanceChild(x, i);
+       return true;
+   }
+
+   static void resetKey(Key *slot, const Key &value) {
+       slot->~Key();
+       new (slot) Key(value);
+   }
+
+   // Child i of x is one entry short: borrow from a sibling, or merge with one.
+   void rebalanceChild(Inner *x, size_t i) {
+       NodeBase *c = x->child[i];
+       NodeBase *left = i > 0 ? x->child[i - 1] : nullptr;
+       NodeBase *right = i < x->count ? x->child[i + 1] : nullptr;
+
+       if (c->leaf) {
+           Leaf *l = static_cast<Leaf *>(c);
+           if (left != nullptr && left->count > LEAF_MIN) {
+               Leaf *s = static_cast<Leaf *>(left);
+               l->openAt(0);
+               l->moveIn(0, s, s->count - 1);
+               s->count--;
+               l->count++;
+               resetKey(x->key(i - 1), l->key(0));
+           } else if (right != nullptr && right->count > LEAF_MIN) {
+               Leaf *s = static_cast<Leaf *>(right);
+               l->moveIn(l->count, s, 0);
+               s->closeAt(0);
+               s->count--;
+               l->count++;
+               resetKey(x->key(i), s->key(0));
+           } else if (left != nullptr) {
+               mergeLeaves(x, i - 1);
+           } else {
+               mergeLeaves(x, i);
+           }
+           return;
+       }
+
+       Inner *n = static_cast<Inner *>(c);
+       if (left != nullptr && left->count > INNER_MIN) {
+           // rotate right through the parent separator
+           Inner *s = static_cast<Inner *>(left);
+           shiftUp(n->key(0), 0, n->count);
+           relocate(n->key(0), x->key(i - 1));
+           for (size_t j = n->count + 1; j > 0; --j) n->child[j] = n->child[j - 1];
+           n->child[0] = s->child[s->count];
+           relocate(x->key(i - 1), s->key(s->count - 1));
+           s->count--;
+           n->count++;
+       } else if (right != nullptr && right->count > INNER_MIN) {
+           Inner *s = static_cast<Inner *>(right);
+           relocate(n->key(n->count), x->key(i));
+           n->child[n->count + 1] = s->child[0];
+           relocate(x->key(i), s->key(0));
+           shiftDown(s->key(0), 0, s->count);
+           for (size_t j = 0; j < s->count; ++j) s->child[j] = s->child[j + 1];
+           s->count--;
+           n->count++;
+       } else if (left != nullptr) {
+           mergeInners(x, i - 1);
+       } else {
+           mergeInners(x, i);
+       }
+   }
+
+   // Drops separator i and child i + 1 of x after that child was merged away.
+   static void removeSeparator(Inner *x, size_t i) {
+       x->key(i)->~Key();
+       shiftDown(x->key(0), i, x->count);
+       for (size_t j = i + 1; j < x->count; ++j) x->child[j] = x->child[j + 1];
+       x->count--;
+   }
+
+   // Appends child i + 1 of x to child i (both leaves) and frees it.
+   void mergeLeaves(Inner *x, size_t i) {
+       Leaf *a = static_cast<Leaf *>(x->child[i]);
+       Leaf *b = static_cast<Leaf *>(x->child[i + 1]);
+       for (size_t j = 0; j < b->count; ++j) a->moveIn(a->count + j, b, j);
+       a->count += b->count;
+       a->next = b->next;
+       if (b->next != nullptr) b->next->prev = a; else tail = a;
+       delete b;
+       removeSeparator(x, i);
+   }
+
+   // Same for inner children; separator i comes down between them.
+   void mergeInners(Inner *x, size_t i) {
+       Inner *a = static_cast<Inner *>(x->child[i]);
+       Inner *b = static_cast<Inner *>(x->child[i + 1]);
+       new (a->key(a->count)) Key(*x->key(i));
+       for (size_t j = 0; j < b->count; ++j) relocate(a->key(a->count + 1 + j), b->key(j));
+       for (size_t j = 0; j <= b->count; ++j) a->child[a->count + 1 + j] = b->child[j];
+       a->count += b->count + 1;
+       delete b;
+       removeSeparator(x, i);
+   }
+
+   bool eraseKey(const Key &key) {
+       if (root == nullptr || !eraseBelow(root, key)) return false;
+       map_size--;
+       if (root->leaf) {
+           if (root->count == 0) {
+               delete static_cast<Leaf *>(root);
+               root = nullptr;
+               head = tail = nullptr;
+           }
+       } else if (root->count == 0) {
+           Inner *old = static_cast<Inner *>(root);
+           root = old->child[0];
+           delete old;
+       }
+       return true;
+   }
+
+   void destroy(NodeBase *node) {
+       if (node == nullptr) return;
+       if (node->leaf) {
+           Leaf *x = static_cast<Leaf *>(node);
+           for (size_t i = 0; i < x->count; ++i) x->slot(i)->~value_type();
+           delete x;
+           return;
+       }
+       Inner *x = static_cast<Inner *>(node);
+       for (size_t i = 0; i <= x->count; ++i) destroy(x->child[i]);
+       for (size_t i = 0; i < x->count; ++i) x->key(i)->~Key();
+       delete x;
+   }
+
+   // Clones node, chaining the cloned leaves behind last in key order.
+   NodeBase *copy(const NodeBase *node, Leaf *&last) {
+       if (node->leaf) {
+           const Leaf *x = static_cast<const Leaf *>(node);
+           Leaf *y = new Leaf;
+           try {
+               for (; y->count < x->count; y->count++) {
+                   new (y->slot(y->count)) value_type(*x->slot(y->count));
+                   y->built(y->count);
+               }
+           } catch (...) {
+               destroy(y);
+               throw;
+           }
+           y->prev = last;
+           if (last != nullptr) last->next = y; else head = y;
+           last = y;
+           return y;
+       }
+       const Inner *x = static_cast<const Inner *>(node);
+       Inner *y = new Inner;
+       try {
+           for (; y->count < x->count; y->count++) new (y->key(y->count)) Key(*x->key(y->count));
+           for (size_t i = 0; i <= x->count; ++i) y->child[i] = nullptr;
+           for (size_t i = 0; i <= x->count; ++i) y->child[i] = copy(x->child[i], last);
+       } catch (...) {
+           destroyPartial(y);
+           throw;
+       }
+       return y;
+   }
+
+   // destroy() for an inner node whose children were only partly cloned.
+   void destroyPartial(Inner *x) {
+       for (size_t i = 0; i <= x->count && x->child[i] != nullptr; ++i) destroy(x->child[i]);
+       for (size_t i = 0; i < x->count; ++i) x->key(i)->~Key();
+       delete x;
+   }
+
+   void copyFrom(const btree_map &other) {
+       if (other.root == nullptr) return;
+       Leaf *last = nullptr;
+       try {
+           root = copy(other.root, last);
+       } catch (...) {
+           root = nullptr;
+           head = tail = nullptr;
+           throw;
+       }
+       tail = last;
+       map_size = other.map_size;
+   }
+
+public:
+   /**
+  * see BidirectionalIterator at CppReference for help.
+  *
+  * if there is anything wrong throw invalid_iterator.
+  *     like it = map.begin(); --it;
+  *       or it = map.end(); ++end();
+    */
+   class const_iterator;
+   class iterator {
+   private:
+       Leaf *leaf; // nullptr for end()
+       size_t index;
+       const btree_map *container;
+
+   public:
+       iterator() : leaf(nullptr), index(0), container(nullptr) {}
+
+       iterator(Leaf *l, size_t i, const btree_map *cont) : leaf(l), index(i), container(cont) {}
+
+       iterator operator++(int) {
+           iterator temp = *this;
+           ++(*this);
+           return temp;
+       }
+
+       iterator &operator++() {
+           if (leaf == nullptr) throw invalid_iterator();
+           if (++index == leaf->count) {
+               leaf = leaf->next;
+               index = 0;
+           }
+           return *this;
+       }
+
+       iterator operator--(int) {
+           iterator temp = *this;
+           --(*this);
+           return temp;
+       }
+
+       iterator &operator--() {
+           if (container == nullptr) throw invalid_iterator();
+           if (leaf == nullptr) {
+               if (container->tail == nullptr) throw invalid_iterator();
+               leaf = container->tail;
+               index = leaf->count - 1;
+           } else if (index > 0) {
+               index--;
+           } else {
+               if (leaf->prev == nullptr) throw invalid_iterator();
+               leaf = leaf->prev;
+               index = leaf->count - 1;
+           }
+           return *this;
+       }
+
+       value_type &operator*() const {
+           if (leaf == nullptr) throw invalid_iterator();
+           return *leaf->slot(index);
+       }
+
+       value_type *operator->() const {
+           if (leaf == nullptr) throw invalid_iterator();
+           return leaf->slot(index);
+       }
+
+       bool operator==(const iterator &rhs) const {
+           return leaf == rhs.leaf && index == rhs.index && container == rhs.container;
+       }
+
+       bool operator==(const const_iterator &rhs) const {
+           return leaf == rhs.leaf && index == rhs.index && container == rhs.container;
+       }
+
+       bool operator!=(const iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       bool operator!=(const const_iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       friend class btree_map;
+       friend class const_iterator;
+   };
+
+   class const_iterator {
+   private:
+       const Leaf *leaf;
+       size_t index;
+       const btree_map *container;
+
+   public:
+       const_iterator() : leaf(nullptr), index(0), container(nullptr) {}
+
+       const_iterator(const Leaf *l, size_t i, const btree_map *cont) : leaf(l), index(i), container(cont) {}
+
+       const_iterator(const iterator &other) : leaf(other.leaf), index(other.index), container(other.container) {}
+
+       const_iterator operator++(int) {
+           const_iterator temp = *this;
+           ++(*this);
+           return temp;
+       }
+
+       const_iterator &operator++() {
+           if (leaf == nullptr) throw invalid_iterator();
+           if (++index == leaf->count) {
+               leaf = leaf->next;
+               index = 0;
+           }
+           return *this;
+       }
+
+       const_iterator operator--(int) {
+           const_iterator temp = *this;
+           --(*this);
+           return temp;
+       }
+
+       const_iterator &operator--() {
+           if (container == nullptr) throw invalid_iterator();
+           if (leaf == nullptr) {
+               if (container->tail == nullptr) throw invalid_iterator();
+               leaf = container->tail;
+               index = leaf->count - 1;
+           } else if (index > 0) {
+               index--;
+           } else {
+               if (leaf->prev == nullptr) throw invalid_iterator();
+               leaf = leaf->prev;
+               index = leaf->count - 1;
+           }
+           return *this;
+       }
+
+       const value_type &operator*() const {
+           if (leaf == nullptr) throw invalid_iterator();
+           return *leaf->slot(index);
+       }
+
+       const value_type *operator->() const {
+           if (leaf == nullptr) throw invalid_iterator();
+           return leaf->slot(index);
+       }
+
+       bool operator==(const const_iterator &rhs) const {
+           return leaf == rhs.leaf && index == rhs.index && container == rhs.container;
+       }
+
+       bool operator==(const iterator &rhs) const {
+           return leaf == rhs.leaf && index == rhs.index && container == rhs.container;
+       }
+
+       bool operator!=(const const_iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       bool operator!=(const iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       friend class btree_map;
+   };
+
+   btree_map() : root(nullptr), head(nullptr), tail(nullptr), map_size(0) {}
+
+   btree_map(const btree_map &other) : root(nullptr), head(nullptr), tail(nullptr), map_size(0), comp(other.comp) {
+       copyFrom(other);
+   }
+
+   btree_map(btree_map &&other) noexcept
+       : root(other.root), head(other.head), tail(other.tail), map_size(other.map_size), comp(other.comp) {
+       other.root = nullptr;
+       other.head = other.tail = nullptr;
+       other.map_size = 0;
+   }
+
+   btree_map &operator=(const btree_map &other) {
+       if (this == &other) return *this;
+       clear();
+       copyFrom(other);
+       return *this;
+   }
+
+   btree_map &operator=(btree_map &&other) noexcept {
+       if (this == &other) return *this;
+       clear();
+       swap(other);
+       return *this;
+   }
+
+   ~btree_map() {
+       destroy(root);
+   }
+
+   void swap(btree_map &other) noexcept {
+       std::swap(root, other.root);
+       std::swap(head, other.head);
+       std::swap(tail, other.tail);
+       std::swap(map_size, other.map_size);
+       std::swap(comp, other.comp);
+   }
+
+   /**
+  * access specified element with bounds checking.
+  * If no such element exists, an exception of type `index_out_of_bound'
+    */
+   T &at(const Key &key) {
+       Leaf *leaf;
+       size_t index;
+       findPos(key, leaf, index);
+       if (leaf == nullptr) throw index_out_of_bound();
+       return leaf->slot(index)->second;
+   }
+
+   const T &at(const Key &key) const {
+       Leaf *leaf;
+       size_t index;
+       findPos(key, leaf, index);
+       if (leaf == nullptr) throw index_out_of_bound();
+       return leaf->slot(index)->second;
+   }
+
+   /**
+  * access specified element, performing an insertion if such key does not already exist.
+    */
+   T &operator[](const Key &key) {
+       bool inserted;
+       DefaultValue make = {key};
+       pair<Leaf *, size_t> pos = insertKey(key, make, inserted);
+       return pos.first->slot(pos.second)->second;
+   }
+
+   /**
+  * behave like at() throw index_out_of_bound if such key does not exist.
+    */
+   const T &operator[](const Key &key) const {
+       return at(key);
+   }
+
+   iterator begin() {
+       return iterator(head, 0, this);
+   }
+
+   const_iterator cbegin() const {
+       return const_iterator(head, 0, this);
+   }
+
+   iterator end() {
+       return iterator(nullptr, 0, this);
+   }
+
+   const_iterator cend() const {
+       return const_iterator(nullptr, 0, this);
+   }
+
+   bool empty() const {
+       return map_size == 0;
+   }
+
+   size_t size() const {
+       return map_size;
+   }
+
+   void clear() {
+       destroy(root);
+       root = nullptr;
+       head = tail = nullptr;
+       map_size = 0;
+   }
+
+   /**
+  * insert an element.
+  * return a pair, the first of the pair is
+  *   the iterator to the new element (or the element that prevented the insertion),
+  *   the second one is true if insert successfully, or false.
+    */
+   pair<iterator, bool> insert(const value_type &value) {
+       bool inserted;
+       CopyValue make = {value};
+       pair<Leaf *, size_t> pos = insertKey(value.first, make, inserted);
+       return pair<iterator, bool>(iterator(pos.first, pos.second, this), inserted);
+   }
+
+   pair<iterator, bool> insert(value_type &&value) {
+       bool inserted;
+       MoveValue make = {value};
+       pair<Leaf *, size_t> pos = insertKey(value.first, make, inserted);
+       return pair<iterator, bool>(iterator(pos.first, pos.second, this), inserted);
+   }
+
+   /**
+  * erase the element at pos.
+  *
+  * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
+    */
+   void erase(iterator pos) {
+       if (pos.container != this || pos.leaf == nullptr) throw invalid_iterator();
+       // every comparison happens on the way down, before the element dies
+       eraseKey(pos.leaf->slot(pos.index)->first);
+   }
+
+   /**
+  * erase the element with key, return the number of elements removed (0 or 1).
+    */
+   size_t erase(const Key &key) {
+       return eraseKey(key) ? 1 : 0;
+   }
+
+   size_t count(const Key &key) const {
+       Leaf *leaf;
+       size_t index;
+       findPos(key, leaf, index);
+       return leaf != nullptr ? 1 : 0;
+   }
+
+   iterator find(const Key &key) {
+       Leaf *leaf;
+       size_t index;
+       findPos(key, leaf, index);
+       return iterator(leaf, index, this);
+   }
+
+   const_iterator find(const Key &key) const {
+       Leaf *leaf;
+       size_t index;
+       findPos(key, leaf, index);
+       return const_iterator(leaf, index, this);
+   }
+
+   iterator lower_bound(const Key &key) {
+       Leaf *leaf;
+       size_t index;
+       lowerPos(key, leaf, index);
+       return iterator(leaf, index, this);
+   }
+
+   const_iterator lower_bound(const Key &key) const {
+       Leaf *leaf;
+       size_t index;
+       lowerPos(key, leaf, index);
+       return const_iterator(leaf, index, this);
+   }
+
+   iterator upper_bound(const Key &key) {
+       Leaf *leaf;
+       size_t index;
+       upperPos(key, leaf, index);
+       return iterator(leaf, index, this);
+   }
+
+   const_iterator upper_bound(const Key &key) const {
+       Leaf *leaf;
+       size_t index;
+       upperPos(key, leaf, index);
+       return const_iterator(leaf, index, this);
+   }
+};
+
+template<class Key, class T, class Compare>
+void swap(btree_map<Key, T, Compare> &lhs, btree_map<Key, T, Compare> &rhs) noexcept {
+   lhs.swap(rhs);
+}
+
+}
+
+#endif
@@ -0,0 +1,281 @@
+/**
+* a map for many reader threads and occasional writers
+*/
+#ifndef SJTU_CONCURRENT_MAP_HPP
+#define SJTU_CONCURRENT_MAP_HPP
+
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <cstddef>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "persistent_map.hpp"
+
+namespace sjtu {
+
+/**
+* an ordered map whose lookups take no lock.
+*
+* the contents are an immutable persistent_map version published through an
+*   atomic pointer. Readers load the current version and search it; writers
+*   serialize on a mutex, derive the next version (copying only the search
+*   path of each write) and publish it with a single store, so a reader sees
+*   either the whole write or none of it.
+*
+* replaced versions are freed with epoch based reclamation: a reader marks
+*   itself active in the epoch it entered (in a slot of its own, so readers do
+*   not contend on a shared counter), and a version is only freed after all
+*   readers of the epoch it was replaced in have left. Freeing is batched, so
+*   writers rarely wait.
+*
+* readers get values by copy, since a reference could outlive its version.
+*   For iteration take a snapshot(): it is O(1) and independent of later
+*   writes.
+*/
+template<
+   class Key,
+   class T,
+   class Compare = std::less <Key>
+   > class concurrent_map {
+public:
+   typedef pair<const Key, T> value_type;
+   typedef persistent_map<Key, T, Compare> snapshot_type;
+
+private:
+   struct Version {
+       snapshot_type map;
+       Version *next; // in the retired list
+
+       explicit Version(const snapshot_type &m) : map(m), next(nullptr) {}
+   };
+
+   // Reader slots are aligned to a cache line each, which also pads them to
+   // one, so that readers on different cores do not share a line.
+   static const size_t SLOTS = 64;
+   static const size_t LINE = 64;
+
+   struct alignas(LINE) ReaderSlot {
+       std::atomic<size_t> active[2]; // readers inside an even / odd epoch
+   };
+
+   // Freeing waits for readers, so it is done once per this many writes.
+   static const size_t RETIRE_BATCH = 64;
+
+   std::atomic<Version *> published;
+   std::atomic<size_t> epoch;
+   mutable ReaderSlot slots[SLOTS];
+
+   std::mutex write_lock; // guards everything below
+   snapshot_type working; // the writers' copy, shares nodes with published
+   Version *retired;
+   size_t retired_count;
+
+   static size_t readerSlot() {
+       static std::atomic<size_t> next_slot(0);
+       static thread_local size_t slot = next_slot.fetch_add(1, std::memory_order_relaxed) % SLOTS;
+       return slot;
+   }
+
+   // Marks the calling thread as reading; the version it loads afterwards
+   // stays alive until exitRead(). Returns the side to pass to exitRead().
+   size_t enterRead() const {
+       std::atomic<size_t> *active = slots[readerSlot()].active;
+       while (true) {
+           size_t e = epoch.load();
+           active[e & 1].fetch_add(1);
+           // A writer that flipped the epoch in between may not wait for us:
+           // register again on the new side.
+           if (epoch.load() == e) return e & 1;
+           active[e & 1].fetch_sub(1);
+       }
+   }
+
+   void exitRead(size_t side) const {
+       slots[readerSlot()].active[side].fetch_sub(1, std::memory_order_release);
+   }
+
+   // Leaves the read side however the lookup ends.
+   class ReadGuard {
+   private:
+       const concurrent_map *owner;
+       size_t side;
+
+   public:
+       explicit ReadGuard(const concurrent_map *m) : owner(m), side(m->enterRead()) {}
+
+       ~ReadGuard() {
+           owner->exitRead(side);
+       }
+
+       const snapshot_type &current() const {
+           return owner->published.load(std::memory_order_seq_cst)->map;
+       }
+   };
+
+   // Waits until no reader can still see a retired version, then frees them
+   // all. Callers hold write_lock.
+   void reclaim() {
+       if (retired == nullptr) return;
+       size_t e = epoch.load();
+       epoch.store(e + 1);
+       for (size_t i = 0; i < SLOTS; ++i) {
+           while (slots[i].active[e & 1].load() != 0) std::this_thread::yield();
+       }
+       while (retired != nullptr) {
+           Version *v = retired;
+           retired = v->next;
+           delete v;
+       }
+       retired_count = 0;
+   }
+
+   // Makes the working copy visible to readers. Callers hold write_lock.
+   void publish() {
+       Version *v = new Version(working);
+       Version *old = published.exchange(v);
+       old->next = retired;
+       retired = old;
+       if (++retired_count >= RETIRE_BATCH) reclaim();
+   }
+
+public:
+   concurrent_map() : epoch(0), retired(nullptr), retired_count(0) {
+       for (size_t i = 0; i < SLOTS; ++i) {
+           slots[i].active[0].store(0);
+           slots[i].active[1].store(0);
+       }
+       published.store(new Version(working));
+   }
+
+   /**
+    * starts from the contents of a snapshot (O(1)).
+    */
+   explicit concurrent_map(const snapshot_type &contents) : concurrent_map() {
+       working = contents;
+       published.load()->map = contents;
+   }
+
+   concurrent_map(const concurrent_map &) = delete;
+
+   concurrent_map &operator=(const concurrent_map &) = delete;
+
+   /**
+    * no thread may use the map any more.
+    */
+   ~concurrent_map() {
+       reclaim();
+       delete published.load();
+   }
+
+   /**
+    * the value stored under key, copied into value; false if there is none.
+    */
+   bool find(const Key &key, T &value) const {
+       ReadGuard guard(this);
+       const typename snapshot_type::Node *x = guard.current().findNode(key);
+       if (x == nullptr) return false;
+       value = x->data.second;
+       return true;
+   }
+
+   /**
+    * the value stored under key. If there is none, an exception of type `index_out_of_bound'
+    */
+   T at(const Key &key) const {
+       ReadGuard guard(this);
+       const typename snapshot_type::Node *x = guard.current().findNode(key);
+       if (x == nullptr) throw index_out_of_bound();
+       return x->data.second;
+   }
+
+   size_t count(const Key &key) const {
+       ReadGuard guard(this);
+       return guard.current().findNode(key) != nullptr ? 1 : 0;
+   }
+
+   size_t size() const {
+       ReadGuard guard(this);
+       return guard.current().size();
+   }
+
+   bool empty() const {
+       return size() == 0;
+   }
+
+   /**
+    * the current contents as a persistent_map of their own (O(1)).
+    */
+   snapshot_type snapshot() const {
+       ReadGuard guard(this);
+       return guard.current();
+   }
+
+   /**
+    * insert value if its key is absent; return whether it was inserted.
+    */
+   bool insert(const value_type &value) {
+       std::lock_guard<std::mutex> lock(write_lock);
+       if (!working.insert(value).second) return false;
+       publish();
+       return true;
+   }
+
+   /**
+    * insert value, or assign obj to the element already there; return whether it was inserted.
+    */
+   template<class M>
+   bool insert_or_assign(const Key &key, M &&obj) {
+       std::lock_guard<std::mutex> lock(write_lock);
+       bool inserted = working.insert_or_assign(key, std::forward<M>(obj)).second;
+       publish();
+       return inserted;
+   }
+
+   /**
+  * erase the element with key, return the number of elements removed (0 or 1).
+    */
+   size_t erase(const Key &key) {
+       std::lock_guard<std::mutex> lock(write_lock);
+       if (working.erase(key) == 0) return 0;
+       publish();
+       return 1;
+   }
+
+   void clear() {
+       std::lock_guard<std::mutex> lock(write_lock);
+       working.clear();
+       publish();
+   }
+
+   /**
+    * runs f on the writers' copy (a persistent_map) and publishes the outcome
+    *   once, so readers see all of f's changes together. If f throws, its
+    *   changes are dropped.
+    */
+   template<class F>
+   void update(F &&f) {
+       std::lock_guard<std::mutex> lock(write_lock);
+       snapshot_type before = working;
+       try {
+           f(working);
+       } catch (...) {
+           working = before;
+           throw;
+       }
+       publish();
+   }
+
+   /**
+    * frees replaced versions now instead of at the next batch.
+    */
+   void synchronize() {
+       std::lock_guard<std::mutex> lock(write_lock);
+       reclaim();
+   }
+};
+
+}
+
+#endif
@@ -7,33 +7,75 @@
 
 namespace sjtu {
 
+// The variant and the detail are string literals, and what() is formatted
+// once into a buffer of the exception itself, so making, copying and
+// throwing an exception never touches the heap.
 class exception {
    protected:
-    const std::string variant = "";
-    std::string detail = "";
+    const char *variant;
+    const char *detail;
+    char message[128];
+
+    // "variant detail", or just the variant without a detail; a detail too
+    // long for the buffer is cut short.
+    void format() noexcept {
+        std::strncpy(message, variant, sizeof(message) - 1);
+        message[sizeof(message) - 1] = '\0';
+        size_t n = std::strlen(message);
+        if (*detail == '\0' || n + 2 >= sizeof(message)) return;
+        message[n] = ' ';
+        message[n + 1] = '\0';
+        std::strncat(message, detail, sizeof(message) - n - 2);
+    }
    public:
-    exception() {}
-    exception(const exception &ec) : variant(ec.variant), detail(ec.detail) {}
-    virtual std::string what() {
-        return variant + " " + detail;
+    exception() noexcept : variant(""), detail("") {
+        format();
+    }
+    explicit exception(const char *variant_, const char *detail_ = "") noexcept
+        : variant(variant_), detail(detail_) {
+        format();
+    }
+    exception(const exception &ec) noexcept : variant(ec.variant), detail(ec.detail) {
+        format();
+    }
+    exception &operator=(const exception &ec) noexcept {
+        variant = ec.variant;
+        detail = ec.detail;
+        format();
+        return *this;
+    }
+    virtual ~exception() {}
+    virtual const char *what() const noexcept {
+        return message;
+    }
+    const char *details() const noexcept {
+        return detail;
     }
 };
 
 class index_out_of_bound : public exception {
-    /* __________________________ */
+   public:
+    index_out_of_bound() noexcept : exception("index_out_of_bound") {}
+    explicit index_out_of_bound(const char *detail_) noexcept : exception("index_out_of_bound", detail_) {}
 };
 
 class runtime_error : public exception {
-    /* __________________________ */
+   public:
+    runtime_error() noexcept : exception("runtime_error") {}
+    explicit runtime_error(const char *detail_) noexcept : exception("runtime_error", detail_) {}
 };
 
 class invalid_iterator : public exception {
-    /* __________________________ */
+   public:
+    invalid_iterator() noexcept : exception("invalid_iterator") {}
+    explicit invalid_iterator(const char *detail_) noexcept : exception("invalid_iterator", detail_) {}
 };
 
 class container_is_empty : public exception {
-    /* __________________________ */
+   public:
+    container_is_empty() noexcept : exception("container_is_empty") {}
+    explicit container_is_empty(const char *detail_) noexcept : exception("container_is_empty", detail_) {}
 };
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,672 @@
+/**
+* a sorted array map with the interface of sjtu::map
+*/
+#ifndef SJTU_FLAT_MAP_HPP
+#define SJTU_FLAT_MAP_HPP
+
+#include <functional>
+#include <algorithm>
+#include <new>
+#include <cstddef>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+* drop-in alternative to sjtu::map for small or read-mostly maps.
+*
+* keys and mapped values are kept in two separate arrays sorted by key, so a
+*   lookup is a branchless binary search that only touches keys, and there is
+*   no per-element node or pointer. Inserting or erasing shifts the elements
+*   behind it: O(n), and it invalidates iterators (like std::vector does).
+*
+* there is no pair object to point to, so *it is a pair of references and
+*   it->first / it->second go through a small proxy: bind *it by value or by
+*   const reference, not by `value_type &'. Otherwise the interface and the
+*   exceptions are the ones of sjtu::map.
+*/
+template<
+   class Key,
+   class T,
+   class Compare = std::less <Key>
+   > class flat_map {
+public:
+   typedef pair<const Key, T> value_type;
+   typedef pair<const Key &, T &> reference;
+   typedef pair<const Key &, const T &> const_reference;
+
+private:
+   // Raw storage: neither Key nor T needs a default constructor. Slots in
+   // [0, length) hold elements, the rest up to cap is unconstructed.
+   Key *keys;
+   T *values;
+   size_t length, cap;
+   Compare comp;
+
+   template<class U>
+   static U *allocate(size_t n) {
+       return n == 0 ? nullptr : static_cast<U *>(::operator new(n * sizeof(U)));
+   }
+
+   // Moves the object at from into the raw slot to and ends the lifetime of from.
+   template<class U>
+   static void relocate(U *to, U *from) {
+       new (to) U(std::move(*from));
+       from->~U();
+   }
+
+   void destroyAll() {
+       for (size_t i = 0; i < length; ++i) {
+           keys[i].~Key();
+           values[i].~T();
+       }
+       length = 0;
+   }
+
+   void freeStorage() {
+       ::operator delete(keys);
+       ::operator delete(values);
+       keys = nullptr;
+       values = nullptr;
+       cap = 0;
+   }
+
+   // Moves the elements to arrays of n slots (n >= length).
+   void reallocate(size_t n) {
+       Key *k = allocate<Key>(n);
+       T *v;
+       try {
+           v = allocate<T>(n);
+       } catch (...) {
+           ::operator delete(k);
+           throw;
+       }
+       for (size_t i = 0; i < length; ++i) {
+           relocate(k + i, keys + i);
+           relocate(v + i, values + i);
+       }
+       ::operator delete(keys);
+       ::operator delete(values);
+       keys = k;
+       values = v;
+       cap = n;
+   }
+
+   // Index of the first key not less than key. The loop always runs
+   // log2(length) times and the step is a select, not a branch.
+   size_t lowerIndex(const Key &key) const {
+       if (length == 0) return 0;
+       const Key *base = keys;
+       size_t n = length;
+       while (n > 1) {
+           size_t half = n / 2;
+           base = comp(base[half], key) ? base + half : base;
+           n -= half;
+       }
+       return static_cast<size_t>(base - keys) + comp(*base, key);
+   }
+
+   // Index of the first key greater than key.
+   size_t upperIndex(const Key &key) const {
+       if (length == 0) return 0;
+       const Key *base = keys;
+       size_t n = length;
+       while (n > 1) {
+           size_t half = n / 2;
+           base = comp(key, base[half]) ? base : base + half;
+           n -= half;
+       }
+       return static_cast<size_t>(base - keys) + !comp(key, *base);
+   }
+
+   // Index of key, or length if it is absent.
+   size_t findIndex(const Key &key) const {
+       size_t i = lowerIndex(key);
+       return i != length && !comp(key, keys[i]) ? i : length;
+   }
+
+   // Puts (key, value) at pos. Both are built before anything moves, so a
+   // throwing constructor leaves the map as it was.
+   template<class K, class V>
+   void insertAt(size_t pos, K &&key, V &&value) {
+       Key k(std::forward<K>(key));
+       T v(std::forward<V>(value));
+       if (length == cap) reallocate(cap < 4 ? 4 : cap * 2);
+       for (size_t i = length; i > pos; --i) {
+           relocate(keys + i, keys + i - 1);
+           relocate(values + i, values + i - 1);
+       }
+       new (keys + pos) Key(std::move(k));
+       new (values + pos) T(std::move(v));
+       length++;
+   }
+
+   void eraseAt(size_t pos) {
+       keys[pos].~Key();
+       values[pos].~T();
+       for (size_t i = pos; i + 1 < length; ++i) {
+           relocate(keys + i, keys + i + 1);
+           relocate(values + i, values + i + 1);
+       }
+       length--;
+   }
+
+   // Appends an element that goes behind all others.
+   template<class K, class V>
+   void append(K &&key, V &&value) {
+       new (keys + length) Key(std::forward<K>(key));
+       try {
+           new (values + length) T(std::forward<V>(value));
+       } catch (...) {
+           keys[length].~Key();
+           throw;
+       }
+       length++;
+   }
+
+   void copyFrom(const flat_map &other) {
+       reallocate(other.length);
+       for (size_t i = 0; i < other.length; ++i) append(other.keys[i], other.values[i]);
+   }
+
+   // Loads [first, last) into an empty map: sorted input is appended as it
+   // comes, anything else is sorted once at the end. Of equal keys the first
+   // one is kept, as insert() would.
+   template<class InputIt>
+   void assignRange(InputIt first, InputIt last) {
+       bool sorted = true;
+       for (; first != last; ++first) {
+           if (length == cap) reallocate(cap < 4 ? 4 : cap * 2);
+           if (length > 0 && !comp(keys[length - 1], first->first)) sorted = false;
+           append(first->first, first->second);
+       }
+       if (!sorted) sortUnsorted();
+   }
+
+   struct IndexLess {
+       const flat_map *owner;
+
+       bool operator()(size_t a, size_t b) const {
+           return owner->comp(owner->keys[a], owner->keys[b]);
+       }
+   };
+
+   void sortUnsorted() {
+       size_t *order = new size_t[length];
+       Key *k = nullptr;
+       T *v = nullptr;
+       size_t kept = 0;
+       try {
+           for (size_t i = 0; i < length; ++i) order[i] = i;
+           IndexLess less = {this};
+           std::stable_sort(order, order + length, less);
+           k = allocate<Key>(length);
+           v = allocate<T>(length);
+           for (size_t i = 0; i < length; ++i) {
+               if (kept > 0 && !comp(k[kept - 1], keys[order[i]])) continue;
+               new (k + kept) Key(std::move(keys[order[i]]));
+               try {
+                   new (v + kept) T(std::move(values[order[i]]));
+               } catch (...) {
+                   k[kept].~Key();
+                   throw;
+               }
+               kept++;
+           }
+       } catch (...) {
+           for (size_t i = 0; i < kept; ++i) {
+               k[i].~Key();
+               v[i].~T();
+           }
+           ::operator delete(k);
+           ::operator delete(v);
+           delete[] order;
+           throw;
+       }
+       delete[] order;
+       destroyAll();
+       freeStorage();
+       keys = k;
+       values = v;
+       length = kept;
+       cap = length;
+   }
+
+public:
+   class const_iterator;
+
+   // *it returns a temporary, it-> needs something to point into.
+   template<class Ref>
+   class arrow_proxy {
+   private:
+       Ref ref;
+
+   public:
+       explicit arrow_proxy(const Ref &r) : ref(r) {}
+
+       Ref *operator->() {
+           return &ref;
+       }
+   };
+
+   /**
+  * see BidirectionalIterator at CppReference for help.
+  *
+  * if there is anything wrong throw invalid_iterator.
+  *     like it = map.begin(); --it;
+  *       or it = map.end(); ++end();
+    */
+   class iterator {
+   private:
+       size_t index;
+       flat_map *container;
+
+   public:
+       iterator() : index(0), container(nullptr) {}
+
+       iterator(size_t i, flat_map *cont) : index(i), container(cont) {}
+
+       iterator operator++(int) {
+           iterator temp = *this;
+           ++(*this);
+           return temp;
+       }
+
+       iterator &operator++() {
+           if (container == nullptr || index >= container->length) throw invalid_iterator();
+           index++;
+           return *this;
+       }
+
+       iterator operator--(int) {
+           iterator temp = *this;
+           --(*this);
+           return temp;
+       }
+
+       iterator &operator--() {
+           if (container == nullptr || index == 0 || index > container->length) throw invalid_iterator();
+           index--;
+           return *this;
+       }
+
+       reference operator*() const {
+           if (container == nullptr || index >= container->length) throw invalid_iterator();
+           return reference(container->keys[index], container->values[index]);
+       }
+
+       arrow_proxy<reference> operator->() const {
+           return arrow_proxy<reference>(**this);
+       }
+
+       bool operator==(const iterator &rhs) const {
+           return index == rhs.index && container == rhs.container;
+       }
+
+       bool operator==(const const_iterator &rhs) const {
+           return index == rhs.index && container == rhs.container;
+       }
+
+       bool operator!=(const iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       bool operator!=(const const_iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       friend class flat_map;
+       friend class const_iterator;
+   };
+
+   class const_iterator {
+   private:
+       size_t index;
+       const flat_map *container;
+
+   public:
+       const_iterator() : index(0), container(nullptr) {}
+
+       const_iterator(size_t i, const flat_map *cont) : index(i), container(cont) {}
+
+       const_iterator(const iterator &other) : index(other.index), container(other.container) {}
+
+       const_iterator operator++(int) {
+           const_iterator temp = *this;
+           ++(*this);
+           return temp;
+       }
+
+       const_iterator &operator++() {
+           if (container == nullptr || index >= container->length) throw invalid_iterator();
+           index++;
+           return *this;
+       }
+
+       const_iterator operator--(int) {
+           const_iterator temp = *this;
+           --(*this);
+           return temp;
+       }
+
+       const_iterator &operator--() {
+           if (container == nullptr || index == 0 || index > container->length) throw invalid_iterator();
+           index--;
+           return *this;
+       }
+
+       const_reference operator*() const {
+           if (container == nullptr || index >= container->length) throw invalid_iterator();
+           return const_reference(container->keys[index], container->values[index]);
+       }
+
+       arrow_proxy<const_reference> operator->() const {
+           return arrow_proxy<const_reference>(**this);
+       }
+
+       bool operator==(const const_iterator &rhs) const {
+           return index == rhs.index && container == rhs.container;
+       }
+
+       bool operator==(const iterator &rhs) const {
+           return index == rhs.index && container == rhs.container;
+       }
+
+       bool operator!=(const const_iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       bool operator!=(const iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       friend class flat_map;
+       friend class iterator;
+   };
+
+   flat_map() : keys(nullptr), values(nullptr), length(0), cap(0) {}
+
+   flat_map(const flat_map &other) : keys(nullptr), values(nullptr), length(0), cap(0), comp(other.comp) {
+       try {
+           copyFrom(other);
+       } catch (...) {
+           destroyAll();
+           freeStorage();
+           throw;
+       }
+   }
+
+   flat_map(flat_map &&other) noexcept
+       : keys(other.keys), values(other.values), length(other.length), cap(other.cap), comp(other.comp) {
+       other.keys = nullptr;
+       other.values = nullptr;
+       other.length = other.cap = 0;
+   }
+
+   /**
+  * builds the map from the elements of [first, last); later duplicates are ignored.
+  * already sorted input is appended in O(n), anything else is sorted once.
+    */
+   template<class InputIt>
+   flat_map(InputIt first, InputIt last) : keys(nullptr), values(nullptr), length(0), cap(0) {
+       try {
+           assignRange(first, last);
+       } catch (...) {
+           destroyAll();
+           freeStorage();
+           throw;
+       }
+   }
+
+   /**
+  * freezes m: its elements are already in order, so this is a single O(n)
+  *   copy into arrays of exactly m.size() slots, without comparing keys.
+    */
+   template<class Policy>
+   explicit flat_map(const map<Key, T, Compare, Policy> &m) : keys(nullptr), values(nullptr), length(0), cap(0) {
+       try {
+           reallocate(m.size());
+           for (typename map<Key, T, Compare, Policy>::const_iterator it = m.cbegin(); it != m.cend(); ++it) {
+               append(it->first, it->second);
+           }
+       } catch (...) {
+           destroyAll();
+           freeStorage();
+           throw;
+       }
+   }
+
+   /**
+  * the same, but the mapped values are moved out of m, which is left empty.
+    */
+   template<class Policy>
+   explicit flat_map(map<Key, T, Compare, Policy> &&m) : keys(nullptr), values(nullptr), length(0), cap(0) {
+       try {
+           reallocate(m.size());
+           for (typename map<Key, T, Compare, Policy>::iterator it = m.begin(); it != m.end(); ++it) {
+               append(it->first, std::move(it->second));
+           }
+       } catch (...) {
+           destroyAll();
+           freeStorage();
+           throw;
+       }
+       m.clear();
+   }
+
+   flat_map &operator=(const flat_map &other) {
+       if (this == &other) return *this;
+       flat_map copy(other);
+       swap(copy);
+       return *this;
+   }
+
+   flat_map &operator=(flat_map &&other) noexcept {
+       if (this == &other) return *this;
+       destroyAll();
+       freeStorage();
+       std::swap(keys, other.keys);
+       std::swap(values, other.values);
+       std::swap(length, other.length);
+       std::swap(cap, other.cap);
+       comp = other.comp;
+       return *this;
+   }
+
+   ~flat_map() {
+       destroyAll();
+       freeStorage();
+   }
+
+   void swap(flat_map &other) noexcept {
+       std::swap(keys, other.keys);
+       std::swap(values, other.values);
+       std::swap(length, other.length);
+       std::swap(cap, other.cap);
+       std::swap(comp, other.comp);
+   }
+
+   /**
+  * access specified element with bounds checking.
+  * If no such element exists, an exception of type `index_out_of_bound'
+    */
+   T &at(const Key &key) {
+       size_t i = findIndex(key);
+       if (i == length) throw index_out_of_bound();
+       return values[i];
+   }
+
+   const T &at(const Key &key) const {
+       size_t i = findIndex(key);
+       if (i == length) throw index_out_of_bound();
+       return values[i];
+   }
+
+   /**
+  * at() without the exception: nullptr if there is no element with key.
+    */
+   T *try_at(const Key &key) {
+       size_t i = findIndex(key);
+       return i != length ? values + i : nullptr;
+   }
+
+   const T *try_at(const Key &key) const {
+       size_t i = findIndex(key);
+       return i != length ? values + i : nullptr;
+   }
+
+   /**
+  * access specified element, performing an insertion if such key does not already exist.
+    */
+   T &operator[](const Key &key) {
+       size_t i = lowerIndex(key);
+       if (i == length || comp(key, keys[i])) insertAt(i, key, T());
+       return values[i];
+   }
+
+   /**
+  * behave like at() throw index_out_of_bound if such key does not exist.
+    */
+   const T &operator[](const Key &key) const {
+       return at(key);
+   }
+
+   iterator begin() {
+       return iterator(0, this);
+   }
+
+   const_iterator cbegin() const {
+       return const_iterator(0, this);
+   }
+
+   iterator end() {
+       return iterator(length, this);
+   }
+
+   const_iterator cend() const {
+       return const_iterator(length, this);
+   }
+
+   bool empty() const {
+       return length == 0;
+   }
+
+   size_t size() const {
+       return length;
+   }
+
+   /**
+  * the number of elements the arrays hold before they have to grow.
+    */
+   size_t capacity() const {
+       return cap;
+   }
+
+   /**
+  * makes room for n elements, so the next inserts up to n do not reallocate.
+    */
+   void reserve(size_t n) {
+       if (n > cap) reallocate(n);
+   }
+
+   /**
+  * gives back the slots that are not in use.
+    */
+   void shrink_to_fit() {
+       if (cap > length) reallocate(length);
+   }
+
+   void clear() {
+       destroyAll();
+   }
+
+   /**
+  * insert an element.
+  * return a pair, the first of the pair is
+  *   the iterator to the new element (or the element that prevented the insertion),
+  *   the second one is true if insert successfully, or false.
+    */
+   pair<iterator, bool> insert(const value_type &value) {
+       size_t i = lowerIndex(value.first);
+       if (i != length && !comp(value.first, keys[i])) return pair<iterator, bool>(iterator(i, this), false);
+       insertAt(i, value.first, value.second);
+       return pair<iterator, bool>(iterator(i, this), true);
+   }
+
+   pair<iterator, bool> insert(value_type &&value) {
+       size_t i = lowerIndex(value.first);
+       if (i != length && !comp(value.first, keys[i])) return pair<iterator, bool>(iterator(i, this), false);
+       insertAt(i, value.first, std::move(value.second));
+       return pair<iterator, bool>(iterator(i, this), true);
+   }
+
+   /**
+  * erase the element at pos.
+  *
+  * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
+    */
+   void erase(iterator pos) {
+       if (pos.container != this || pos.index >= length) throw invalid_iterator();
+       eraseAt(pos.index);
+   }
+
+   /**
+  * erase the element with key, return the number of elements removed (0 or 1).
+    */
+   size_t erase(const Key &key) {
+       size_t i = findIndex(key);
+       if (i == length) return 0;
+       eraseAt(i);
+       return 1;
+   }
+
+   /**
+  * Returns the number of elements with key, either 1 or 0.
+    */
+   size_t count(const Key &key) const {
+       return findIndex(key) != length ? 1 : 0;
+   }
+
+   iterator find(const Key &key) {
+       return iterator(findIndex(key), this);
+   }
+
+   const_iterator find(const Key &key) const {
+       return const_iterator(findIndex(key), this);
+   }
+
+   /**
+  * return an iterator to the first element whose key is not less than key,
+  *   or end() if there is none.
+    */
+   iterator lower_bound(const Key &key) {
+       return iterator(lowerIndex(key), this);
+   }
+
+   const_iterator lower_bound(const Key &key) const {
+       return const_iterator(lowerIndex(key), this);
+   }
+
+   /**
+  * return an iterator to the first element whose key is greater than key,
+  *   or end() if there is none.
+    */
+   iterator upper_bound(const Key &key) {
+       return iterator(upperIndex(key), this);
+   }
+
+   const_iterator upper_bound(const Key &key) const {
+       return const_iterator(upperIndex(key), this);
+   }
+};
+
+template<class Key, class T, class Compare>
+void swap(flat_map<Key, T, Compare> &lhs, flat_map<Key, T, Compare> &rhs) noexcept {
+   lhs.swap(rhs);
+}
+
+}
+
+#endif
@@ -0,0 +1,440 @@
+/**
+* an immutable map laid out for fast point lookups
+*/
+#ifndef SJTU_FROZEN_MAP_HPP
+#define SJTU_FROZEN_MAP_HPP
+
+#include <functional>
+#include <new>
+#include <cstddef>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "map.hpp"
+
+namespace sjtu {
+
+namespace detail {
+
+struct image_access;
+
+// The read-only part of frozen_map: lookups and iteration over keys and
+// values stored in Eytzinger order. It does not own the arrays, so the
+// same code also answers queries on a map_image in place.
+template<class Key, class T, class Compare>
+class eytzinger_view {
+public:
+   typedef pair<const Key, T> value_type;
+   typedef pair<const Key &, const T &> const_reference;
+
+protected:
+   // Slots 1 .. length hold elements; slot 0 is never used, so that the
+   // index arithmetic needs no offset.
+   const Key *keys;
+   const T *values;
+   size_t length;
+   Compare comp;
+
+   eytzinger_view() : keys(nullptr), values(nullptr), length(0) {}
+
+   explicit eytzinger_view(const Compare &c) : keys(nullptr), values(nullptr), length(0), comp(c) {}
+
+   void swapView(eytzinger_view &other) {
+       std::swap(keys, other.keys);
+       std::swap(values, other.values);
+       std::swap(length, other.length);
+       std::swap(comp, other.comp);
+   }
+
+   static void prefetch(const void *p) {
+#if defined(__GNUC__)
+       __builtin_prefetch(p);
+#else
+       (void)p;
+#endif
+   }
+
+   // In-order walk over the implicit tree; 0 stands for "past the end".
+   size_t first() const {
+       if (length == 0) return 0;
+       size_t k = 1;
+       while (2 * k <= length) k = 2 * k;
+       return k;
+   }
+
+   size_t last() const {
+       if (length == 0) return 0;
+       size_t k = 1;
+       while (2 * k + 1 <= length) k = 2 * k + 1;
+       return k;
+   }
+
+   size_t next(size_t k) const {
+       if (2 * k + 1 <= length) {
+           k = 2 * k + 1;
+           while (2 * k <= length) k = 2 * k;
+           return k;
+       }
+       // Climb while k is a right child, then once more.
+       while (k & 1) k >>= 1;
+       return k >> 1;
+   }
+
+   size_t prev(size_t k) const {
+       if (2 * k <= length) {
+           k = 2 * k;
+           while (2 * k + 1 <= length) k = 2 * k + 1;
+           return k;
+       }
+       while (k != 0 && !(k & 1)) k >>= 1;
+       return k >> 1;
+   }
+
+   // The search goes right past every key less than key, so once it falls
+   // off the tree the answer is the node where it last went left: drop the
+   // trailing right turns and the left turn before them.
+   static size_t lastLeftTurn(size_t k) {
+       while (k & 1) k >>= 1;
+       return k >> 1;
+   }
+
+   // Slot of the first key not less than key, or 0 if there is none.
+   size_t lowerIndex(const Key &key) const {
+       size_t k = 1;
+       while (k <= length) {
+           if (4 * k <= length) prefetch(keys + 4 * k);
+           k = 2 * k + comp(keys[k], key);
+       }
+       return lastLeftTurn(k);
+   }
+
+   // Slot of the first key greater than key, or 0 if there is none.
+   size_t upperIndex(const Key &key) const {
+       size_t k = 1;
+       while (k <= length) {
+           if (4 * k <= length) prefetch(keys + 4 * k);
+           k = 2 * k + !comp(key, keys[k]);
+       }
+       return lastLeftTurn(k);
+   }
+
+   size_t findIndex(const Key &key) const {
+       size_t k = lowerIndex(key);
+       return k != 0 && !comp(key, keys[k]) ? k : 0;
+   }
+
+public:
+   // *it returns a temporary, it-> needs something to point into.
+   class arrow_proxy {
+   private:
+       const_reference ref;
+
+   public:
+       explicit arrow_proxy(const const_reference &r) : ref(r) {}
+
+       const_reference *operator->() {
+           return &ref;
+       }
+   };
+
+   /**
+  * see BidirectionalIterator at CppReference for help.
+  *
+  * if there is anything wrong throw invalid_iterator.
+  *     like it = map.begin(); --it;
+  *       or it = map.end(); ++end();
+    */
+   class const_iterator {
+   private:
+       size_t index;
+       const eytzinger_view *container;
+
+   public:
+       const_iterator() : index(0), container(nullptr) {}
+
+       const_iterator(size_t i, const eytzinger_view *cont) : index(i), container(cont) {}
+
+       const_iterator operator++(int) {
+           const_iterator temp = *this;
+           ++(*this);
+           return temp;
+       }
+
+       const_iterator &operator++() {
+           if (container == nullptr || index == 0) throw invalid_iterator();
+           index = container->next(index);
+           return *this;
+       }
+
+       const_iterator operator--(int) {
+           const_iterator temp = *this;
+           --(*this);
+           return temp;
+       }
+
+       const_iterator &operator--() {
+           if (container == nullptr) throw invalid_iterator();
+           size_t k = index == 0 ? container->last() : container->prev(index);
+           if (k == 0) throw invalid_iterator();
+           index = k;
+           return *this;
+       }
+
+       const_reference operator*() const {
+           if (container == nullptr || index == 0) throw invalid_iterator();
+           return const_reference(container->keys[index], container->values[index]);
+       }
+
+       arrow_proxy operator->() const {
+           return arrow_proxy(**this);
+       }
+
+       bool operator==(const const_iterator &rhs) const {
+           return index == rhs.index && container == rhs.container;
+       }
+
+       bool operator!=(const const_iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       friend class eytzinger_view;
+   };
+
+   typedef const_iterator iterator;
+
+   /**
+  * access specified element with bounds checking.
+  * If no such element exists, an exception of type `index_out_of_bound'
+    */
+   const T &at(const Key &key) const {
+       size_t k = findIndex(key);
+       if (k == 0) throw index_out_of_bound();
+       return values[k];
+   }
+
+   /**
+  * at() without the exception: nullptr if there is no element with key.
+    */
+   const T *try_at(const Key &key) const {
+       size_t k = findIndex(key);
+       return k != 0 ? values + k : nullptr;
+   }
+
+   /**
+  * behave like at() throw index_out_of_bound if such key does not exist.
+    */
+   const T &operator[](const Key &key) const {
+       return at(key);
+   }
+
+   const_iterator begin() const {
+       return const_iterator(first(), this);
+   }
+
+   const_iterator cbegin() const {
+       return const_iterator(first(), this);
+   }
+
+   const_iterator end() const {
+       return const_iterator(0, this);
+   }
+
+   const_iterator cend() const {
+       return const_iterator(0, this);
+   }
+
+   bool empty() const {
+       return length == 0;
+   }
+
+   size_t size() const {
+       return length;
+   }
+
+   /**
+  * Returns the number of elements with key, either 1 or 0.
+    */
+   size_t count(const Key &key) const {
+       return findIndex(key) != 0 ? 1 : 0;
+   }
+
+   const_iterator find(const Key &key) const {
+       return const_iterator(findIndex(key), this);
+   }
+
+   /**
+  * return an iterator to the first element whose key is not less than key,
+  *   or end() if there is none.
+    */
+   const_iterator lower_bound(const Key &key) const {
+       return const_iterator(lowerIndex(key), this);
+   }
+
+   /**
+  * return an iterator to the first element whose key is greater than key,
+  *   or end() if there is none.
+    */
+   const_iterator upper_bound(const Key &key) const {
+       return const_iterator(upperIndex(key), this);
+   }
+};
+
+}
+
+/**
+* a read-only copy of a map, for lookup tables that never change.
+*
+* the keys are stored in Eytzinger (breadth first) order: slot 1 is the root
+*   and the children of slot k are slots 2k and 2k + 1. The first levels of
+*   every search share the same few cache lines, and while slot k is compared
+*   the four grandchildren (slots 4k .. 4k + 3, next to each other) are
+*   already being prefetched, so a lookup on a table far larger than the
+*   cache waits for memory about once per two levels instead of once per
+*   level, as a sorted array or a tree does.
+*
+* iteration is still in key order: the iterators walk the implicit tree.
+*   Keys and mapped values sit in separate arrays, so *it is a pair of
+*   references (as in flat_map), and nothing can be inserted, erased or
+*   assigned through the map.
+*/
+template<
+   class Key,
+   class T,
+   class Compare = std::less <Key>
+   > class frozen_map : public detail::eytzinger_view<Key, T, Compare> {
+private:
+   typedef detail::eytzinger_view<Key, T, Compare> View;
+
+   template<class U>
+   static U *allocate(size_t n) {
+       return n == 0 ? nullptr : static_cast<U *>(::operator new((n + 1) * sizeof(U)));
+   }
+
+   // Destroys the elements in the first `built' slots in order (all of them
+   // if built == length) and frees the arrays.
+   void destroy(size_t built) {
+       size_t k = this->first();
+       for (size_t i = 0; i < built; ++i, k = this->next(k)) {
+           this->keys[k].~Key();
+           this->values[k].~T();
+       }
+       ::operator delete(const_cast<Key *>(this->keys));
+       ::operator delete(const_cast<T *>(this->values));
+       this->keys = nullptr;
+       this->values = nullptr;
+       this->length = 0;
+   }
+
+   // Fills the slots from n sorted elements: an in-order walk of the
+   // implicit tree visits them in the same order. Move selects whether the
+   // mapped values are moved out of the source.
+   template<bool Move, class It>
+   void build(It it, size_t n) {
+       Key *k_slots = allocate<Key>(n);
+       T *v_slots;
+       try {
+           v_slots = allocate<T>(n);
+       } catch (...) {
+           ::operator delete(k_slots);
+           throw;
+       }
+       this->keys = k_slots;
+       this->values = v_slots;
+       this->length = n;
+       size_t built = 0;
+       try {
+           for (size_t k = this->first(); built < n; k = this->next(k)) {
+               new (k_slots + k) Key(it->first);
+               try {
+                   if (Move) new (v_slots + k) T(std::move(it->second));
+                   else new (v_slots + k) T(it->second);
+               } catch (...) {
+                   k_slots[k].~Key();
+                   throw;
+               }
+               // Only step the source while it has elements left.
+               if (++built < n) ++it;
+           }
+       } catch (...) {
+           destroy(built);
+           throw;
+       }
+   }
+
+public:
+   frozen_map() {}
+
+   frozen_map(const frozen_map &other) : View(other.comp) {
+       // Same layout, so the copy goes slot by slot in in-order.
+       build<false>(other.cbegin(), other.length);
+   }
+
+   frozen_map(frozen_map &&other) noexcept : View(other.comp) {
+       this->swapView(other);
+   }
+
+   /**
+  * freezes m in O(n), straight from its in-order traversal.
+    */
+   template<class Policy>
+   explicit frozen_map(const map<Key, T, Compare, Policy> &m) {
+       build<false>(m.cbegin(), m.size());
+   }
+
+   /**
+  * the same, but the mapped values are moved out of m, which is left empty.
+    */
+   template<class Policy>
+   explicit frozen_map(map<Key, T, Compare, Policy> &&m) {
+       build<true>(m.begin(), m.size());
+       m.clear();
+   }
+
+   frozen_map &operator=(const frozen_map &other) {
+       if (this == &other) return *this;
+       frozen_map copy(other);
+       swap(copy);
+       return *this;
+   }
+
+   frozen_map &operator=(frozen_map &&other) noexcept {
+       if (this == &other) return *this;
+       destroy(this->length);
+       this->swapView(other);
+       return *this;
+   }
+
+   ~frozen_map() {
+       destroy(this->length);
+   }
+
+   void swap(frozen_map &other) noexcept {
+       this->swapView(other);
+   }
+
+   friend struct detail::image_access;
+};
+
+template<class Key, class T, class Compare>
+void swap(frozen_map<Key, T, Compare> &lhs, frozen_map<Key, T, Compare> &rhs) noexcept {
+   lhs.swap(rhs);
+}
+
+/**
+* a frozen_map with the contents of m.
+*/
+template<class Key, class T, class Compare, class Policy>
+frozen_map<Key, T, Compare> freeze(const map<Key, T, Compare, Policy> &m) {
+   return frozen_map<Key, T, Compare>(m);
+}
+
+/**
+* the same, moving the mapped values out of m.
+*/
+template<class Key, class T, class Compare, class Policy>
+frozen_map<Key, T, Compare> freeze(map<Key, T, Compare, Policy> &&m) {
+   return frozen_map<Key, T, Compare>(std::move(m));
+}
+
+}
+
+#endif
@@ -7,15 +7,323 @@
 // only for std::less<T>
 #include <functional>
 #include <cstddef>
+// only for save() / load()
+#include <iostream>
 #include "utility.hpp"
 #include "exceptions.hpp"
 
+// Iterators of sjtu::map check every use and throw invalid_iterator on
+// misuse. Define SJTU_MAP_UNCHECKED_ITERATORS to make them a bare node
+// pointer without any checks, for release builds.
+//
+// A comparator may also offer int compare3(a, b), negative, zero or
+// positive as a goes before, with or after b. Lookups and insertions then
+// compare once per level instead of twice. It has to agree with the
+// comparator itself, which the bounds and split() still use.
+
 namespace sjtu {
 
+/**
+* compile-time options of sjtu::map. derive from it and override what you
+*   need, every feature that is off costs nothing.
+*/
+struct default_map_policy {
+   // keep subtree sizes in the nodes for nth(), rank() and distance()
+   static const bool order_statistics = false;
+   // count comparisons, node allocations, rebalancing work and search depth
+   // for stats()
+   static const bool collect_stats = false;
+};
+
+struct order_statistics_policy : default_map_policy {
+   static const bool order_statistics = true;
+};
+
+struct collect_stats_policy : default_map_policy {
+   static const bool collect_stats = true;
+};
+
+/**
+* what a map with Policy::collect_stats has done since it was made or since
+*   its last reset_stats().
+*/
+struct map_stats {
+   size_t comparisons;       // calls of the comparator
+   size_t allocations;       // nodes created
+   size_t deallocations;     // nodes destroyed
+   size_t rotations;         // single rotations while rebalancing
+   size_t fix_insert_steps;  // rounds of rebalancing after an insertion
+   size_t fix_delete_steps;  // rounds of rebalancing after an erasure
+   size_t searches;          // descents from the root
+   size_t total_depth;       // nodes visited by all of them
+   size_t max_depth;         // nodes visited by the deepest one
+
+   map_stats()
+       : comparisons(0), allocations(0), deallocations(0), rotations(0), fix_insert_steps(0),
+         fix_delete_steps(0), searches(0), total_depth(0), max_depth(0) {}
+
+   double average_depth() const {
+       return searches == 0 ? 0.0 : static_cast<double>(total_depth) / searches;
+   }
+};
+
+/**
+* tag for the range constructor / assign() of sjtu::map: the caller promises
+*   that the keys are strictly increasing, so they are not even compared.
+*/
+struct sorted_unique_t {};
+const sorted_unique_t sorted_unique = sorted_unique_t();
+
+namespace detail {
+
+// Subtree size carried by every node when order statistics are enabled,
+// together with the few operations that keep it right. The disabled
+// version is an empty base whose operations compile to nothing.
+template<bool Enabled>
+struct subtree_size {
+   size_t count;
+
+   subtree_size() : count(1) {}
+
+   template<class Link>
+   static size_t of(const Link *x) {
+       return x == nullptr ? 0 : x->count;
+   }
+
+   template<class Link>
+   static void pull(Link *x) {
+       x->count = 1 + of(x->left) + of(x->right);
+   }
+
+   // y has just been rotated above x.
+   template<class Link>
+   static void rotated(Link *x, Link *y) {
+       y->count = x->count;
+       pull(x);
+   }
+
+   template<class Link>
+   static void assign(Link *dst, const Link *src) {
+       dst->count = src->count;
+   }
+
+   // Adds delta to every node from x up to (but excluding) stop.
+   template<class Link>
+   static void adjust(Link *x, const Link *stop, size_t delta) {
+       for (; x != stop; x = x->parent()) x->count += delta;
+   }
+};
+
+template<>
+struct subtree_size<false> {
+   template<class Link> static void pull(Link *) {}
+   template<class Link> static void rotated(Link *, Link *) {}
+   template<class Link> static void assign(Link *, const Link *) {}
+   template<class Link> static void adjust(Link *, const Link *, size_t) {}
+};
+
+template<class T>
+struct void_of {
+   typedef void type;
+};
+
+// Only for the detection below, never called.
+template<class T>
+T &&declval_of();
+
+// Three-way comparison, so that a search step costs one call instead of
+// comp(a, b) and then comp(b, a). It is only taken from an explicit
+// Compare::compare3(a, b), which returns an int below, equal to or above zero
+// as a goes before, with or after b. operator<=> of the keys is not used even
+// for std::less, which is defined by operator< and may disagree with it.
+template<class Compare, class A, class B, class = void>
+struct three_way {};
+
+template<class Compare, class A, class B>
+struct three_way<Compare, A, B, typename void_of<decltype(
+       declval_of<const Compare &>().compare3(declval_of<const A &>(), declval_of<const B &>()))>::type> {
+   static int order(const Compare &c, const A &a, const B &b) {
+       return c.compare3(a, b);
+   }
+};
+
+// What the descents of map use: three_way where it exists, else two calls.
+template<class Compare, class A, class B, class = void>
+struct key_order {
+   static int of(const Compare &c, const A &a, const B &b) {
+       return c(a, b) ? -1 : c(b, a) ? 1 : 0;
+   }
+};
+
+template<class Compare, class A, class B>
+struct key_order<Compare, A, B, typename void_of<decltype(
+       three_way<Compare, A, B>::order(declval_of<const Compare &>(), declval_of<const A &>(),
+                                       declval_of<const B &>()))>::type> {
+   static int of(const Compare &c, const A &a, const B &b) {
+       return three_way<Compare, A, B>::order(c, a, b);
+   }
+};
+
+// The counters of collect_stats. They are kept inside the comparator, which
+// every operation has at hand anyway, so without stats the map stores the
+// plain Compare and every hook below is an empty inline function.
+template<class Compare, bool Enabled>
+struct instrumented {
+   typedef Compare type;
+
+   static const Compare &plain(const type &c) {
+       return c;
+   }
+
+   static void allocated(const type &) {}
+   static void freed(const type &, size_t = 1) {}
+   static void rotated(const type &) {}
+   static void fixInsertStep(const type &) {}
+   static void fixDeleteStep(const type &) {}
+   static void searched(const type &, size_t) {}
+
+   static map_stats get(const type &) {
+       return map_stats();
+   }
+
+   static void reset(const type &) {}
+};
+
+template<class Compare>
+struct instrumented<Compare, true> {
+   struct type {
+       Compare compare;
+       mutable map_stats stats;
+
+       type() {}
+
+       explicit type(const Compare &c) : compare(c) {}
+
+       // The counts stay with their map: copies start from zero.
+       type(const type &other) : compare(other.compare) {}
+
+       type &operator=(const type &other) {
+           compare = other.compare;
+           return *this;
+       }
+
+       template<class A, class B>
+       bool operator()(const A &a, const B &b) const {
+           ++stats.comparisons;
+           return compare(a, b);
+       }
+
+       // offered exactly when Compare has a three-way comparison of A and B
+       template<class A, class B>
+       auto compare3(const A &a, const B &b) const -> decltype(three_way<Compare, A, B>::order(compare, a, b)) {
+           ++stats.comparisons;
+           return three_way<Compare, A, B>::order(compare, a, b);
+       }
+   };
+
+   static const Compare &plain(const type &c) {
+       return c.compare;
+   }
+
+   static void allocated(const type &c) {
+       ++c.stats.allocations;
+   }
+
+   static void freed(const type &c, size_t n = 1) {
+       c.stats.deallocations += n;
+   }
+
+   static void rotated(const type &c) {
+       ++c.stats.rotations;
+   }
+
+   static void fixInsertStep(const type &c) {
+       ++c.stats.fix_insert_steps;
+   }
+
+   static void fixDeleteStep(const type &c) {
+       ++c.stats.fix_delete_steps;
+   }
+
+   static void searched(const type &c, size_t depth) {
+       ++c.stats.searches;
+       c.stats.total_depth += depth;
+       if (depth > c.stats.max_depth) c.stats.max_depth = depth;
+   }
+
+   static map_stats get(const type &c) {
+       return c.stats;
+   }
+
+   static void reset(const type &c) {
+       c.stats = map_stats();
+   }
+};
+
+// Lookups templated on the probe type are only offered for comparators that
+// declare is_transparent, i.e. promise to compare keys with other types
+// directly. K only makes the test depend on the call.
+template<class Compare, class K, class R, class = void>
+struct if_transparent {};
+
+template<class Compare, class K, class R>
+struct if_transparent<Compare, K, R, typename void_of<typename Compare::is_transparent>::type> {
+   typedef R type;
+};
+
+// The element count of a map together with its comparator (and the counters
+// of collect_stats, if any). An empty comparator is a base rather than a
+// member, so it takes no room. The map holds this as a member instead of
+// deriving from it, so that it never converts to its comparator.
+#if defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)
+template<class C, bool Base = __is_empty(C) && !__is_final(C)>
+#else
+template<class C, bool Base = false>
+#endif
+struct sized_compare {
+   C held;
+   size_t count;
+
+   sized_compare() : held(), count(0) {}
+
+   sized_compare(const C &c) : held(c), count(0) {}
+
+   C &get() {
+       return held;
+   }
+
+   const C &get() const {
+       return held;
+   }
+};
+
+template<class C>
+struct sized_compare<C, true> : C {
+   size_t count;
+
+   sized_compare() : C(), count(0) {}
+
+   sized_compare(const C &c) : C(c), count(0) {}
+
+   C &get() {
+       return *this;
+   }
+
+   const C &get() const {
+       return *this;
+   }
+};
+
+// Node level access for the algorithms in parallel.hpp.
+struct map_access;
+
+}
+
 template<
    class Key,
    class T,
-   class Compare = std::less <Key>
+   class Compare = std::less <Key>,
+   class Policy = default_map_policy
    > class map {
 public:
    /**
@@ -26,277 +334,1503 @@ public:
    typedef pair<const Key, T> value_type;
 
 private:
-   // Red-Black Tree node structure
-   struct Node {
+   // Red-Black Tree links. The header below is a bare NodeBase, every real
+   // element is a Node.
+   typedef detail::subtree_size<Policy::order_statistics> Counter;
+   typedef detail::instrumented<Compare, Policy::collect_stats> Stats;
+
+   friend struct detail::map_access;
+
+   // The color lives in bit 0 of the parent link (set for red): nodes are
+   // pointer aligned, so that bit of a real address is always clear, and a
+   // separate bool would cost a whole word of padding per node.
+   struct NodeBase : Counter {
+       NodeBase *left, *right;
+       size_t link;
+
+       explicit NodeBase(NodeBase *p = nullptr)
+           : left(nullptr), right(nullptr), link(reinterpret_cast<size_t>(p) | 1) {}
+
+       NodeBase *parent() const {
+           return reinterpret_cast<NodeBase *>(link & ~static_cast<size_t>(1));
+       }
+
+       void setParent(NodeBase *p) {
+           link = reinterpret_cast<size_t>(p) | (link & 1);
+       }
+
+       bool red() const {
+           return (link & 1) != 0;
+       }
+
+       void setRed(bool red) {
+           link = (link & ~static_cast<size_t>(1)) | static_cast<size_t>(red);
+       }
+   };
+
+   static_assert(sizeof(size_t) == sizeof(NodeBase *) && alignof(NodeBase) >= 2,
+                 "the color bit needs pointer sized, aligned parent links");
+
+   struct Node : NodeBase {
        value_type data;
-       Node *left, *right, *parent;
-       bool color; // true for red, false for black
 
-       Node(const value_type &val, Node *p = nullptr)
-           : data(val), left(nullptr), right(nullptr), parent(p), color(true) {}
+       // data is built in place from whatever the caller forwards.
+       template<class... Args>
+       explicit Node(NodeBase *p, Args &&...args) : NodeBase(p), data(std::forward<Args>(args)...) {}
    };
 
-   Node *root;
-   Node *end_node; // sentinel node for end()
-   size_t map_size;
-   Compare comp;
+   // Slab allocator for Node: slots are carved out of chunks that grow
+   // geometrically, erased slots are recycled through a free list and all
+   // chunks are handed back at once by release(). Every map owns one pool.
+   //
+   // After split() or join() nodes of one map can sit in chunks another map
+   // allocated, so such chunks move to a reference counted group that all
+   // the maps involved point to; the last of them frees it. Groups that meet
+   // in a join are merged: the chunks move to one of them and the other
+   // keeps that one alive. Allocation state stays per pool either way.
+   class NodePool {
+   private:
+       union Slot {
+           Slot *next;
+           alignas(Node) unsigned char storage[sizeof(Node)];
+       };
+
+   public:
+       struct Group {
+           size_t refs;
+           Slot *chunks, *oldest;
+           Group *into; // the group that took over the chunks
+       };
+
+   private:
+       static const size_t MIN_CHUNK = 16;
+       static const size_t MAX_CHUNK = 4096;
+
+       Slot *chunks;    // slot 0 of every chunk links to the previous chunk
+       Slot *oldest;    // the end of that list
+       Slot *free_list;
+       Slot *cursor, *limit; // untouched tail of the newest chunk
+       size_t next_chunk;
+       Group *group;
+
+       void grow() {
+           Slot *chunk = new Slot[next_chunk + 1];
+           chunk[0].next = chunks;
+           if (chunks == nullptr) oldest = chunk;
+           chunks = chunk;
+           cursor = chunk + 1;
+           limit = chunk + next_chunk + 1;
+           if (next_chunk < MAX_CHUNK) next_chunk *= 2;
+       }
+
+       static void freeChunks(Slot *list) {
+           while (list != nullptr) {
+               Slot *prev = list[0].next;
+               delete[] list;
+               list = prev;
+           }
+       }
+
+       // Appends the chunk list [list, last] to g.
+       static void give(Group *g, Slot *list, Slot *last) {
+           if (list == nullptr) return;
+           last[0].next = g->chunks;
+           if (g->chunks == nullptr) g->oldest = last;
+           g->chunks = list;
+       }
+
+       static Group *topOf(Group *g) {
+           while (g->into != nullptr) g = g->into;
+           return g;
+       }
+
+       // Hands the own chunks to the group, which is created on first use;
+       // returns the group that holds them.
+       Group *shared() {
+           if (group == nullptr) {
+               group = new Group;
+               group->refs = 1;
+               group->chunks = group->oldest = nullptr;
+               group->into = nullptr;
+           }
+           Group *top = topOf(group);
+           if (top != group) {
+               top->refs++;
+               drop(group);
+               group = top;
+           }
+           give(group, chunks, oldest);
+           chunks = oldest = nullptr;
+           return group;
+       }
+
+   public:
+       // The tree left behind by clear_deferred(): its nodes live in these
+       // chunks and are destroyed a few at a time. It travels with the chunks.
+       NodeBase *doomed;
+       size_t doomed_count;
+
+       NodePool()
+           : chunks(nullptr), oldest(nullptr), free_list(nullptr), cursor(nullptr), limit(nullptr),
+             next_chunk(MIN_CHUNK), group(nullptr), doomed(nullptr), doomed_count(0) {}
+
+       NodePool(const NodePool &) = delete;
+       NodePool &operator=(const NodePool &) = delete;
+
+       ~NodePool() {
+           release();
+       }
+
+       void *allocate() {
+           if (free_list != nullptr) {
+               Slot *slot = free_list;
+               free_list = slot->next;
+               return slot->storage;
+           }
+           if (cursor == limit) grow();
+           return (cursor++)->storage;
+       }
+
+       void deallocate(void *p) {
+           Slot *slot = static_cast<Slot *>(p);
+           slot->next = free_list;
+           free_list = slot;
+       }
+
+       // Makes sure the next n allocations are contiguous. Whatever is left
+       // of the current chunk goes to the free list so it is not lost.
+       void reserve(size_t n) {
+           if (static_cast<size_t>(limit - cursor) >= n) return;
+           while (cursor != limit) deallocate((cursor++)->storage);
+           size_t saved = next_chunk;
+           if (next_chunk < n) next_chunk = n;
+           grow();
+           next_chunk = saved;
+       }
+
+       void swap(NodePool &other) noexcept {
+           std::swap(chunks, other.chunks);
+           std::swap(oldest, other.oldest);
+           std::swap(free_list, other.free_list);
+           std::swap(cursor, other.cursor);
+           std::swap(limit, other.limit);
+           std::swap(next_chunk, other.next_chunk);
+           std::swap(group, other.group);
+           std::swap(doomed, other.doomed);
+           std::swap(doomed_count, other.doomed_count);
+       }
+
+       // Lets nodes allocated by either pool live in a map of the other: both
+       // end up in one group holding all their chunks.
+       void share(NodePool &other) {
+           if (other.group == nullptr) {
+               other.group = shared();
+               other.group->refs++;
+           }
+           adopt(other.shared());
+       }
+
+       // A reference to the group holding this pool's chunks, for a node
+       // that leaves the map on its own.
+       Group *lend() {
+           Group *g = shared();
+           g->refs++;
+           return g;
+       }
+
+       // Lets nodes from the chunks of g live in this map.
+       void adopt(Group *g) {
+           Group *mine = shared();
+           g = topOf(g);
+           if (g == mine) return;
+           give(mine, g->chunks, g->oldest);
+           g->chunks = g->oldest = nullptr;
+           g->into = mine;
+           mine->refs++;
+       }
+
+       static void drop(Group *g) {
+           while (g != nullptr && --g->refs == 0) {
+               Group *into = g->into;
+               freeChunks(g->chunks);
+               delete g;
+               g = into;
+           }
+       }
+
+       // Frees every chunk, or gives up this pool's share of them. The nodes
+       // of this map must already be destroyed.
+       void release() {
+           freeChunks(chunks);
+           drop(group);
+           chunks = oldest = free_list = cursor = limit = nullptr;
+           group = nullptr;
+           next_chunk = MIN_CHUNK;
+       }
+   };
+
+   // Sentinel in the style of libstdc++: header.parent() is the root (whose
+   // parent is &header), header.left / header.right cache the leftmost and
+   // rightmost nodes, and &header itself is end(). An empty map has
+   // header.left == header.right == &header.
+   NodeBase header;
+   // sized.count is the number of elements
+   detail::sized_compare<typename Stats::type> sized;
+   NodePool pool;
+
+   typename Stats::type &comparator() {
+       return sized.get();
+   }
+
+   const typename Stats::type &comparator() const {
+       return sized.get();
+   }
+
+   template<class A, class B>
+   bool comp(const A &a, const B &b) const {
+       return comparator()(a, b);
+   }
+
+   // Negative, zero or positive as a goes before, with or after b.
+   template<class A, class B>
+   int keyOrder(const A &a, const B &b) const {
+       return detail::key_order<typename Stats::type, A, B>::of(comparator(), a, b);
+   }
+
+   NodeBase *root() const {
+       return header.parent();
+   }
+
+   void setRoot(NodeBase *x) {
+       header.setParent(x);
+   }
+
+   static const Key &keyOf(const NodeBase *x) {
+       return static_cast<const Node *>(x)->data.first;
+   }
+
+   void resetHeader() {
+       setRoot(nullptr);
+       header.left = header.right = &header;
+       sized.count = 0;
+   }
+
+   // Re-points the root at this header after header links were copied over.
+   void adoptHeader() {
+       if (root() == nullptr) {
+           header.left = header.right = &header;
+       } else {
+           root()->setParent(&header);
+       }
+   }
+
+   // Elements left by clear_deferred() that each new node destroys first,
+   // so the old tree is gone before the new one has grown to its size.
+   static const size_t RECLAIM_STEP = 4;
+
+   template<class... Args>
+   Node *createNode(Args &&...args) {
+       if (pool.doomed != nullptr) reclaimSome(RECLAIM_STEP);
+       void *p = pool.allocate();
+       Node *node;
+       try {
+           node = new (p) Node(std::forward<Args>(args)...);
+       } catch (...) {
+           pool.deallocate(p);
+           throw;
+       }
+       Stats::allocated(comparator());
+       return node;
+   }
+
+   void dropNode(NodeBase *x) {
+       Node *node = static_cast<Node *>(x);
+       node->~Node();
+       Stats::freed(comparator());
+#ifndef SJTU_MAP_UNCHECKED_ITERATORS
+       // No linked node has a null parent: iterators still pointing here
+       // see that the element is gone, as long as the slot is not reused.
+       new (static_cast<void *>(node)) NodeBase(nullptr);
+#endif
+       pool.deallocate(node);
+   }
 
    // Helper functions
-   void leftRotate(Node *x) {
-       Node *y = x->right;
+   void leftRotate(NodeBase *x) {
+       NodeBase *y = x->right;
        x->right = y->left;
        if (y->left != nullptr) {
-           y->left->parent = x;
+           y->left->setParent(x);
        }
-       y->parent = x->parent;
-       if (x->parent == nullptr) {
-           root = y;
-       } else if (x == x->parent->left) {
-           x->parent->left = y;
+       y->setParent(x->parent());
+       if (x == root()) {
+           setRoot(y);
+       } else if (x == x->parent()->left) {
+           x->parent()->left = y;
        } else {
-           x->parent->right = y;
+           x->parent()->right = y;
        }
        y->left = x;
-       x->parent = y;
+       x->setParent(y);
+       Counter::rotated(x, y);
+       Stats::rotated(comparator());
    }
 
-   void rightRotate(Node *x) {
-       Node *y = x->left;
+   void rightRotate(NodeBase *x) {
+       NodeBase *y = x->left;
        x->left = y->right;
        if (y->right != nullptr) {
-           y->right->parent = x;
+           y->right->setParent(x);
        }
-       y->parent = x->parent;
-       if (x->parent == nullptr) {
-           root = y;
-       } else if (x == x->parent->right) {
-           x->parent->right = y;
+       y->setParent(x->parent());
+       if (x == root()) {
+           setRoot(y);
+       } else if (x == x->parent()->right) {
+           x->parent()->right = y;
        } else {
-           x->parent->left = y;
+           x->parent()->left = y;
        }
        y->right = x;
-       x->parent = y;
-   }
-
-   void fixInsert(Node *z) {
-       while (z->parent != nullptr && z->parent->color) {
-           if (z->parent == z->parent->parent->left) {
-               Node *y = z->parent->parent->right;
-               if (y != nullptr && y->color) {
-                   z->parent->color = false;
-                   y->color = false;
-                   z->parent->parent->color = true;
-                   z = z->parent->parent;
+       x->setParent(y);
+       Counter::rotated(x, y);
+       Stats::rotated(comparator());
+   }
+
+   // Returns whether the root had to be painted black at the end, which is
+   // when the black height of the tree grew.
+   bool fixInsert(NodeBase *z) {
+       while (z != root() && z->parent()->red()) {
+           Stats::fixInsertStep(comparator());
+           if (z->parent() == z->parent()->parent()->left) {
+               NodeBase *y = z->parent()->parent()->right;
+               if (y != nullptr && y->red()) {
+                   z->parent()->setRed(false);
+                   y->setRed(false);
+                   z->parent()->parent()->setRed(true);
+                   z = z->parent()->parent();
                } else {
-                   if (z == z->parent->right) {
-                       z = z->parent;
+                   if (z == z->parent()->right) {
+                       z = z->parent();
                        leftRotate(z);
                    }
-                   z->parent->color = false;
-                   z->parent->parent->color = true;
-                   rightRotate(z->parent->parent);
+                   z->parent()->setRed(false);
+                   z->parent()->parent()->setRed(true);
+                   rightRotate(z->parent()->parent());
                }
            } else {
-               Node *y = z->parent->parent->left;
-               if (y != nullptr && y->color) {
-                   z->parent->color = false;
-                   y->color = false;
-                   z->parent->parent->color = true;
-                   z = z->parent->parent;
+               NodeBase *y = z->parent()->parent()->left;
+               if (y != nullptr && y->red()) {
+                   z->parent()->setRed(false);
+                   y->setRed(false);
+                   z->parent()->parent()->setRed(true);
+                   z = z->parent()->parent();
                } else {
-                   if (z == z->parent->left) {
-                       z = z->parent;
+                   if (z == z->parent()->left) {
+                       z = z->parent();
                        rightRotate(z);
                    }
-                   z->parent->color = false;
-                   z->parent->parent->color = true;
-                   leftRotate(z->parent->parent);
+                   z->parent()->setRed(false);
+                   z->parent()->parent()->setRed(true);
+                   leftRotate(z->parent()->parent());
                }
            }
        }
-       root->color = false;
+       bool grew = root()->red();
+       root()->setRed(false);
+       return grew;
    }
 
-   void transplant(Node *u, Node *v) {
-       if (u->parent == nullptr) {
-           root = v;
-       } else if (u == u->parent->left) {
-           u->parent->left = v;
+   void transplant(NodeBase *u, NodeBase *v) {
+       if (u == root()) {
+           setRoot(v);
+       } else if (u == u->parent()->left) {
+           u->parent()->left = v;
        } else {
-           u->parent->right = v;
+           u->parent()->right = v;
        }
        if (v != nullptr) {
-           v->parent = u->parent;
+           v->setParent(u->parent());
        }
    }
 
-   Node *minimum(Node *x) const {
+   static NodeBase *minimum(NodeBase *x) {
        while (x->left != nullptr) {
            x = x->left;
        }
        return x;
    }
 
-   Node *maximum(Node *x) const {
-       if (x == nullptr) return nullptr;
+   static NodeBase *maximum(NodeBase *x) {
        while (x->right != nullptr) {
            x = x->right;
        }
        return x;
    }
 
-   void fixDelete(Node *x) {
-       while (x != root && (x == nullptr || !x->color)) {
-           if (x == x->parent->left) {
-               Node *w = x->parent->right;
-               if (w->color) {
-                   w->color = false;
-                   x->parent->color = true;
-                   leftRotate(x->parent);
-                   w = x->parent->right;
+   // In-order neighbours. They walk through &header at either end, so the
+   // callers decide whether that is end() or an error.
+   static const NodeBase *successor(const NodeBase *x, const NodeBase *head) {
+       if (x->right != nullptr) {
+           x = x->right;
+           while (x->left != nullptr) x = x->left;
+           return x;
+       }
+       const NodeBase *p = x->parent();
+       while (p != head && x == p->right) {
+           x = p;
+           p = p->parent();
+       }
+       return p;
+   }
+
+   static const NodeBase *predecessor(const NodeBase *x, const NodeBase *head) {
+       if (x->left != nullptr) {
+           x = x->left;
+           while (x->right != nullptr) x = x->right;
+           return x;
+       }
+       const NodeBase *p = x->parent();
+       while (p != head && x == p->left) {
+           x = p;
+           p = p->parent();
+       }
+       return p;
+   }
+
+   // x may be nullptr (an empty leaf), so its parent is passed in explicitly.
+   void fixDelete(NodeBase *x, NodeBase *parent) {
+       while (x != root() && (x == nullptr || !x->red())) {
+           Stats::fixDeleteStep(comparator());
+           if (x == parent->left) {
+               NodeBase *w = parent->right;
+               if (w->red()) {
+                   w->setRed(false);
+                   parent->setRed(true);
+                   leftRotate(parent);
+                   w = parent->right;
                }
-               if ((w->left == nullptr || !w->left->color) &&
-                   (w->right == nullptr || !w->right->color)) {
-                   w->color = true;
-                   x = x->parent;
+               if ((w->left == nullptr || !w->left->red()) &&
+                   (w->right == nullptr || !w->right->red())) {
+                   w->setRed(true);
+                   x = parent;
+                   parent = x->parent();
                } else {
-                   if (w->right == nullptr || !w->right->color) {
-                       if (w->left != nullptr) w->left->color = false;
-                       w->color = true;
+                   if (w->right == nullptr || !w->right->red()) {
+                       w->left->setRed(false);
+                       w->setRed(true);
                        rightRotate(w);
-                       w = x->parent->right;
+                       w = parent->right;
                    }
-                   w->color = x->parent->color;
-                   x->parent->color = false;
-                   if (w->right != nullptr) w->right->color = false;
-                   leftRotate(x->parent);
-                   x = root;
+                   w->setRed(parent->red());
+                   parent->setRed(false);
+                   if (w->right != nullptr) w->right->setRed(false);
+                   leftRotate(parent);
+                   x = root();
                }
            } else {
-               Node *w = x->parent->left;
-               if (w->color) {
-                   w->color = false;
-                   x->parent->color = true;
-                   rightRotate(x->parent);
-                   w = x->parent->left;
+               NodeBase *w = parent->left;
+               if (w->red()) {
+                   w->setRed(false);
+                   parent->setRed(true);
+                   rightRotate(parent);
+                   w = parent->left;
                }
-               if ((w->right == nullptr || !w->right->color) &&
-                   (w->left == nullptr || !w->left->color)) {
-                   w->color = true;
-                   x = x->parent;
+               if ((w->right == nullptr || !w->right->red()) &&
+                   (w->left == nullptr || !w->left->red())) {
+                   w->setRed(true);
+                   x = parent;
+                   parent = x->parent();
                } else {
-                   if (w->left == nullptr || !w->left->color) {
-                       if (w->right != nullptr) w->right->color = false;
-                       w->color = true;
+                   if (w->left == nullptr || !w->left->red()) {
+                       w->right->setRed(false);
+                       w->setRed(true);
                        leftRotate(w);
-                       w = x->parent->left;
+                       w = parent->left;
                    }
-                   w->color = x->parent->color;
-                   x->parent->color = false;
-                   if (w->left != nullptr) w->left->color = false;
-                   rightRotate(x->parent);
-                   x = root;
+                   w->setRed(parent->red());
+                   parent->setRed(false);
+                   if (w->left != nullptr) w->left->setRed(false);
+                   rightRotate(parent);
+                   x = root();
                }
            }
        }
-       if (x != nullptr) x->color = false;
+       if (x != nullptr) x->setRed(false);
    }
 
-   void destroy(Node *node) {
-       if (node == nullptr) return;
-       destroy(node->left);
-       destroy(node->right);
-       delete node;
+   // Runs the destructors only; the memory goes back with pool.release().
+   // Left children are rotated up until there is none, which flattens the
+   // tree into its right spine as it goes, so no recursion or stack is needed.
+   void destroy(NodeBase *node) {
+       while (node != nullptr) {
+           if (node->left != nullptr) {
+               NodeBase *left = node->left;
+               node->left = left->right;
+               left->right = node;
+               node = left;
+           } else {
+               NodeBase *next = node->right;
+               static_cast<Node *>(node)->~Node();
+               Stats::freed(comparator());
+               node = next;
+           }
+       }
    }
 
-   Node *copy(Node *node, Node *parent) {
-       if (node == nullptr) return nullptr;
-       Node *new_node = new Node(node->data, parent);
-       new_node->color = node->color;
-       new_node->left = copy(node->left, new_node);
-       new_node->right = copy(node->right, new_node);
+   NodeBase *cloneNode(const NodeBase *node, NodeBase *parent) {
+       NodeBase *new_node = createNode(parent, static_cast<const Node *>(node)->data);
+       new_node->setRed(node->red());
+       Counter::assign(new_node, node);
        return new_node;
    }
 
-   Node *findNode(const Key &key) const {
-       Node *current = root;
+   // Pre-order clone driven by the parent links of both trees, so it needs
+   // no recursion. The partial copy is always a well-formed tree, which lets
+   // a throwing copy constructor be cleaned up with destroy().
+   NodeBase *copy(const NodeBase *node, NodeBase *parent) {
+       if (node == nullptr) return nullptr;
+       NodeBase *top = cloneNode(node, parent);
+       try {
+           const NodeBase *src = node;
+           NodeBase *dst = top;
+           while (true) {
+               if (src->left != nullptr && dst->left == nullptr) {
+                   dst->left = cloneNode(src->left, dst);
+                   src = src->left;
+                   dst = dst->left;
+               } else if (src->right != nullptr && dst->right == nullptr) {
+                   dst->right = cloneNode(src->right, dst);
+                   src = src->right;
+                   dst = dst->right;
+               } else if (src == node) {
+                   break;
+               } else {
+                   src = src->parent();
+                   dst = dst->parent();
+               }
+           }
+       } catch (...) {
+           destroy(top);
+           throw;
+       }
+       return top;
+   }
+
+   // Expects an empty map. The pool is sized up front so the whole clone is
+   // laid out in one chunk, in pre-order.
+   void copyFrom(const map &other) {
+       if (other.root() == nullptr) return;
+       pool.reserve(other.sized.count);
+       try {
+           setRoot(copy(other.root(), &header));
+       } catch (...) {
+           pool.release();
+           resetHeader();
+           throw;
+       }
+       adoptHeader();
+       header.left = minimum(root());
+       header.right = maximum(root());
+       sized.count = other.sized.count;
+   }
+
+   // What an iterator knows besides its node: the map it belongs to, unless
+   // iterators are unchecked. Then it is an empty base and any iterator is
+   // taken to belong to the map it is used with.
+#ifndef SJTU_MAP_UNCHECKED_ITERATORS
+   class IteratorOwner {
+   private:
+       const map *container;
+
+   public:
+       explicit IteratorOwner(const map *m = nullptr) : container(m) {}
+
+       bool of(const map *m) const {
+           return container == m;
+       }
+
+       bool operator==(const IteratorOwner &rhs) const {
+           return container == rhs.container;
+       }
+
+       // Throws unless x is an element of the map; end() is not one.
+       void checkElement(const NodeBase *x) const {
+           if (x == nullptr || x == &container->header || x->parent() == nullptr) throw invalid_iterator();
+       }
+
+       const NodeBase *next(const NodeBase *x) const {
+           checkElement(x);
+           return successor(x, &container->header);
+       }
+
+       // --end() is the cached rightmost node; stepping back from begin()
+       // (or from end() of an empty map) lands on the header.
+       const NodeBase *prev(const NodeBase *x) const {
+           if (x == nullptr) throw invalid_iterator();
+           if (x != &container->header) checkElement(x);
+           const NodeBase *before = x == &container->header ? container->header.right
+                                                             : predecessor(x, &container->header);
+           if (before == &container->header) throw invalid_iterator();
+           return before;
+       }
+   };
+#else
+   class IteratorOwner {
+   public:
+       explicit IteratorOwner(const map * = nullptr) {}
+
+       bool of(const map *) const {
+           return true;
+       }
+
+       bool operator==(const IteratorOwner &) const {
+           return true;
+       }
+
+       void checkElement(const NodeBase *) const {}
+
+       // Steps in the style of libstdc++, which need no header pointer: the
+       // header is the red node that is its root's parent, and climbing from
+       // the last element ends at it.
+       const NodeBase *next(const NodeBase *x) const {
+           if (x->right != nullptr) {
+               x = x->right;
+               while (x->left != nullptr) x = x->left;
+               return x;
+           }
+           const NodeBase *y = x->parent();
+           while (x == y->right) {
+               x = y;
+               y = y->parent();
+           }
+           return x->right != y ? y : x;
+       }
+
+       const NodeBase *prev(const NodeBase *x) const {
+           if (x->red() && (x->parent() == nullptr || x->parent()->parent() == x)) return x->right;
+           if (x->left != nullptr) {
+               x = x->left;
+               while (x->right != nullptr) x = x->right;
+               return x;
+           }
+           const NodeBase *y = x->parent();
+           while (x == y->left) {
+               x = y;
+               y = y->parent();
+           }
+           return y;
+       }
+   };
+#endif
+
+   // Throws unless an iterator with this owner and node may be used on this
+   // map; end() is fine.
+   void checkPosition(const IteratorOwner &owner, const NodeBase *at) const {
+       if (!owner.of(this) || at == nullptr) throw invalid_iterator();
+       if (at != &header) owner.checkElement(at);
+   }
+
+   // Exchanges everything but the comparator.
+   void swapTree(map &other) noexcept {
+       NodeBase *top = root();
+       setRoot(other.root());
+       other.setRoot(top);
+       std::swap(header.left, other.header.left);
+       std::swap(header.right, other.header.right);
+       adoptHeader();
+       other.adoptHeader();
+       std::swap(sized.count, other.sized.count);
+       pool.swap(other.pool);
+   }
+
+   // Whether nodes can be dropped without running their destructors. Only
+   // the compiler can tell; where it cannot be asked, assume they cannot.
+#if defined(__clang__)
+   static const bool TRIVIAL_NODES = __is_trivially_destructible(Key) && __is_trivially_destructible(T);
+#elif defined(__GNUC__) || defined(_MSC_VER)
+   static const bool TRIVIAL_NODES = __has_trivial_destructor(Key) && __has_trivial_destructor(T);
+#else
+   static const bool TRIVIAL_NODES = false;
+#endif
+
+   // Ends the lifetime of every node, the tree and what clear_deferred()
+   // left; the memory itself is the pool's business.
+   void destroyNodes() {
+       if (TRIVIAL_NODES) {
+           Stats::freed(comparator(), sized.count);
+       } else {
+           destroy(root());
+       }
+       destroy(pool.doomed);
+       pool.doomed = nullptr;
+       pool.doomed_count = 0;
+   }
+
+   // Destroys up to n nodes of the tree left by clear_deferred(), with the
+   // walk of destroy() picked up where it stopped; the slots are reused.
+   void reclaimSome(size_t n) {
+       NodeBase *node = pool.doomed;
+       for (; node != nullptr && n > 0;) {
+           if (node->left != nullptr) {
+               NodeBase *left = node->left;
+               node->left = left->right;
+               left->right = node;
+               node = left;
+           } else {
+               NodeBase *next = node->right;
+               dropNode(node);
+               node = next;
+               n--;
+               pool.doomed_count--;
+           }
+       }
+       pool.doomed = node;
+   }
+
+   // Drops every node and returns all chunks to the system in bulk.
+   void destroyAll() {
+       destroyNodes();
+       pool.release();
+       resetHeader();
+   }
+
+   template<class K>
+   Node *findNode(const K &key) const {
+       NodeBase *current = root();
+       size_t depth = 0;
+       while (current != nullptr) {
+           depth++;
+           int c = keyOrder(key, keyOf(current));
+           if (c < 0) {
+               current = current->left;
+           } else if (c > 0) {
+               current = current->right;
+           } else {
+               break;
+           }
+       }
+       Stats::searched(comparator(), depth);
+       return static_cast<Node *>(current);
+   }
+
+   // Single descent shared by every insertion path: returns the node holding
+   // key, or nullptr with parent/to_left telling where the new node belongs.
+   Node *locate(const Key &key, NodeBase *&parent, bool &to_left) const {
+       NodeBase *current = root();
+       parent = const_cast<NodeBase *>(&header);
+       to_left = false;
+       size_t depth = 0;
        while (current != nullptr) {
-           if (comp(key, current->data.first)) {
+           depth++;
+           parent = current;
+           int c = keyOrder(key, keyOf(current));
+           if (c < 0) {
+               to_left = true;
                current = current->left;
-           } else if (comp(current->data.first, key)) {
+           } else if (c > 0) {
+               to_left = false;
                current = current->right;
            } else {
-               return current;
+               break;
+           }
+       }
+       Stats::searched(comparator(), depth);
+       return static_cast<Node *>(current);
+   }
+
+   // Like locate(), but first tries to place key right next to hint, which
+   // should be the element that will follow it. When key fits between hint
+   // and its predecessor (or behind the last element for hint == end()),
+   // this costs one or two comparisons instead of a descent.
+   Node *locateHint(const NodeBase *hint, const Key &key, NodeBase *&parent, bool &to_left) const {
+       if (hint == &header) {
+           if (sized.count > 0 && comp(keyOf(header.right), key)) {
+               parent = header.right;
+               to_left = false;
+               return nullptr;
+           }
+           return locate(key, parent, to_left);
+       }
+       int c = keyOrder(key, keyOf(hint));
+       if (c < 0) {
+           if (hint == header.left) {
+               parent = const_cast<NodeBase *>(hint);
+               to_left = true;
+               return nullptr;
+           }
+           const NodeBase *before = predecessor(hint, &header);
+           if (comp(keyOf(before), key)) {
+               // neighbours in order: one of the two inner links is free
+               if (before->right == nullptr) {
+                   parent = const_cast<NodeBase *>(before);
+                   to_left = false;
+               } else {
+                   parent = const_cast<NodeBase *>(hint);
+                   to_left = true;
+               }
+               return nullptr;
            }
+           return locate(key, parent, to_left);
+       }
+       if (c > 0) {
+           if (hint == header.right) {
+               parent = const_cast<NodeBase *>(hint);
+               to_left = false;
+               return nullptr;
+           }
+           const NodeBase *after = successor(hint, &header);
+           if (comp(key, keyOf(after))) {
+               if (hint->right == nullptr) {
+                   parent = const_cast<NodeBase *>(hint);
+                   to_left = false;
+               } else {
+                   parent = const_cast<NodeBase *>(after);
+                   to_left = true;
+               }
+               return nullptr;
+           }
+           return locate(key, parent, to_left);
+       }
+       return static_cast<Node *>(const_cast<NodeBase *>(hint));
+   }
+
+   // Hangs z at the spot reported by locate() and restores the RB invariants,
+   // keeping the cached leftmost / rightmost nodes up to date.
+   Node *linkNode(Node *z, NodeBase *parent, bool to_left) {
+       z->setParent(parent);
+       if (parent == &header) {
+           setRoot(z);
+           header.left = header.right = z;
+       } else if (to_left) {
+           parent->left = z;
+           if (parent == header.left) header.left = z;
+       } else {
+           parent->right = z;
+           if (parent == header.right) header.right = z;
        }
-       return nullptr;
+
+       Counter::adjust(parent, &header, 1);
+       fixInsert(z);
+       sized.count++;
+       return z;
+   }
+
+   // linkNode() for a node that was unlinked elsewhere.
+   Node *relinkNode(NodeBase *x, NodeBase *parent, bool to_left) {
+       x->left = x->right = nullptr;
+       x->setRed(true);
+       Counter::pull(x);
+       return linkNode(static_cast<Node *>(x), parent, to_left);
    }
 
    Node *insertNode(const value_type &value) {
-       Node *y = nullptr;
-       Node *x = root;
+       NodeBase *parent;
+       bool to_left;
+       Node *x = locate(value.first, parent, to_left);
+       if (x != nullptr) return x; // key already exists
+       return linkNode(createNode(parent, value), parent, to_left);
+   }
+
+   // Lookup-or-insert in one descent; the mapped value is only built on a miss.
+   template<class K, class... Args>
+   pair<Node *, bool> tryEmplaceNode(K &&key, Args &&...args) {
+       NodeBase *parent;
+       bool to_left;
+       Node *x = locate(key, parent, to_left);
+       if (x != nullptr) return pair<Node *, bool>(x, false);
+
+       Node *z = createValueNode(parent, std::forward<K>(key), std::forward<Args>(args)...);
+       return pair<Node *, bool>(linkNode(z, parent, to_left), true);
+   }
+
+   // Builds (key, T(args...)). With a single argument the mapped value is
+   // constructed straight inside the node instead of being moved in.
+   template<class K>
+   Node *createValueNode(NodeBase *parent, K &&key) {
+       return createNode(parent, std::forward<K>(key), T());
+   }
+
+   template<class K, class Arg>
+   Node *createValueNode(NodeBase *parent, K &&key, Arg &&arg) {
+       return createNode(parent, std::forward<K>(key), std::forward<Arg>(arg));
+   }
+
+   template<class K, class Arg1, class Arg2, class... Args>
+   Node *createValueNode(NodeBase *parent, K &&key, Arg1 &&arg1, Arg2 &&arg2, Args &&...args) {
+       return createNode(parent, std::forward<K>(key),
+                         T(std::forward<Arg1>(arg1), std::forward<Arg2>(arg2), std::forward<Args>(args)...));
+   }
 
+   // The key is only known once the value exists, so build first and throw
+   // the node away again if the key turns out to be taken.
+   template<class... Args>
+   pair<Node *, bool> emplaceNode(Args &&...args) {
+       return insertBuilt(createNode(nullptr, std::forward<Args>(args)...));
+   }
+
+   // Links an already constructed node, or drops it if its key is taken.
+   pair<Node *, bool> insertBuilt(Node *z, const NodeBase *hint = nullptr) {
+       NodeBase *parent;
+       bool to_left;
+       Node *x;
+       try {
+           x = hint != nullptr ? locateHint(hint, z->data.first, parent, to_left)
+                               : locate(z->data.first, parent, to_left);
+       } catch (...) {
+           dropNode(z);
+           throw;
+       }
+       if (x != nullptr) {
+           dropNode(z);
+           return pair<Node *, bool>(x, false);
+       }
+       return pair<Node *, bool>(linkNode(z, parent, to_left), true);
+   }
+
+   // First node whose key is not less than key, or &header.
+   template<class K>
+   NodeBase *lowerBound(const K &key) const {
+       NodeBase *x = root();
+       const NodeBase *y = &header;
+       size_t depth = 0;
        while (x != nullptr) {
-           y = x;
-           if (comp(value.first, x->data.first)) {
+           depth++;
+           if (!comp(keyOf(x), key)) {
+               y = x;
                x = x->left;
-           } else if (comp(x->data.first, value.first)) {
+           } else {
                x = x->right;
+           }
+       }
+       Stats::searched(comparator(), depth);
+       return const_cast<NodeBase *>(y);
+   }
+
+   // First node whose key is greater than key, or &header.
+   template<class K>
+   NodeBase *upperBound(const K &key) const {
+       NodeBase *x = root();
+       const NodeBase *y = &header;
+       size_t depth = 0;
+       while (x != nullptr) {
+           depth++;
+           if (comp(key, keyOf(x))) {
+               y = x;
+               x = x->left;
            } else {
-               return x; // key already exists
+               x = x->right;
            }
        }
+       Stats::searched(comparator(), depth);
+       return const_cast<NodeBase *>(y);
+   }
 
-       Node *z = new Node(value, y);
-       if (y == nullptr) {
-           root = z;
-       } else if (comp(value.first, y->data.first)) {
-           y->left = z;
-       } else {
-           y->right = z;
+   // Tallest possible tree: a red-black tree is at most twice as high as a
+   // perfectly balanced one.
+   static const size_t MAX_HEIGHT = 2 * 8 * sizeof(size_t);
+
+   // Batched lookups. BATCH_LANES searches advance in lockstep, one level
+   // per round, and every step prefetches the node it moves to, so the cache
+   // misses of different keys overlap instead of queueing behind each other.
+   // The keys are taken BATCH_BLOCK at a time so the bookkeeping stays on
+   // the stack.
+   static const size_t BATCH_LANES = 8;
+   static const size_t BATCH_BLOCK = 256;
+
+   static void prefetchNode(const NodeBase *x) {
+#if defined(__GNUC__)
+       __builtin_prefetch(x);
+       __builtin_prefetch(&keyOf(x));
+#else
+       (void)x;
+#endif
+   }
+
+   // One interleaved search. When the keys are sorted every lane resolves a
+   // run of them and keeps the path of the last one: the next key starts
+   // from the deepest node on it whose subtree still holds that key, so the
+   // shared part of the path is not walked (nor compared) again.
+   struct BatchLane {
+       size_t next, end, stride; // keys next, next + stride, ... below end are left
+       NodeBase *x;              // where the search for keys[next] stands
+       size_t depth;
+       size_t top;
+       NodeBase *path[MAX_HEIGHT];
+       bool went_left[MAX_HEIGHT];
+   };
+
+   void startSearch(BatchLane &lane, const Key &key, bool finger) const {
+       lane.depth = 0;
+       if (finger) {
+           while (lane.top > 0 && !(lane.went_left[lane.top - 1] && comp(key, keyOf(lane.path[lane.top - 1])))) {
+               lane.top--;
+           }
+           if (lane.top > 0) {
+               lane.x = lane.path[--lane.top];
+               return;
+           }
        }
+       lane.x = root();
+   }
 
-       fixInsert(z);
-       map_size++;
-       return z;
+   // Puts the node holding *keys[i] (or nullptr) into found[i], for i < n.
+   void findBlock(const Key *const *keys, NodeBase **found, size_t n) const {
+       bool finger = true;
+       for (size_t i = 1; i < n && finger; ++i) {
+           if (comp(*keys[i], *keys[i - 1])) finger = false;
+       }
+       size_t lanes = n < BATCH_LANES ? n : BATCH_LANES;
+       BatchLane lane[BATCH_LANES];
+       size_t active = 0;
+       for (size_t l = 0; l < lanes; ++l) {
+           // sorted: a contiguous run per lane; otherwise every lanes-th key
+           lane[l].next = finger ? n * l / lanes : l;
+           lane[l].end = finger ? n * (l + 1) / lanes : n;
+           lane[l].stride = finger ? 1 : lanes;
+           lane[l].top = 0;
+           if (lane[l].next < lane[l].end) {
+               startSearch(lane[l], *keys[lane[l].next], false);
+               active++;
+           }
+       }
+       while (active > 0) {
+           for (size_t l = 0; l < lanes; ++l) {
+               BatchLane &ln = lane[l];
+               if (ln.next >= ln.end) continue;
+               NodeBase *x = ln.x;
+               bool done = x == nullptr;
+               if (!done) {
+                   const Key &key = *keys[ln.next];
+                   ln.depth++;
+                   int c = keyOrder(key, keyOf(x));
+                   bool left = c < 0;
+                   if (c == 0) {
+                       done = true;
+                   } else {
+                       if (finger) {
+                           ln.path[ln.top] = x;
+                           ln.went_left[ln.top++] = left;
+                       }
+                       ln.x = left ? x->left : x->right;
+                       if (ln.x != nullptr) prefetchNode(ln.x);
+                       x = nullptr;
+                   }
+               }
+               if (!done) continue;
+               found[ln.next] = x;
+               Stats::searched(comparator(), ln.depth);
+               if (finger && x != nullptr) {
+                   ln.path[ln.top] = x;
+                   ln.went_left[ln.top++] = false;
+               }
+               ln.next += ln.stride;
+               if (ln.next < ln.end) {
+                   startSearch(ln, *keys[ln.next], finger);
+               } else {
+                   active--;
+               }
+           }
+       }
    }
 
-   void deleteNode(Node *z) {
-       if (z == nullptr) return;
+   // Calls emit(node or nullptr) for every key of [first, last), in order.
+   template<class ForwardIt, class F>
+   void findEach(ForwardIt first, ForwardIt last, F emit) const {
+       const Key *keys[BATCH_BLOCK];
+       NodeBase *found[BATCH_BLOCK];
+       while (first != last) {
+           size_t n = 0;
+           for (; n < BATCH_BLOCK && first != last; ++first) keys[n++] = &*first;
+           findBlock(keys, found, n);
+           for (size_t i = 0; i < n; ++i) emit(found[i]);
+       }
+   }
 
-       Node *y = z;
-       Node *x;
-       bool y_original_color = y->color;
+   // Node with k smaller keys, or &header when k >= size().
+   NodeBase *nthNode(size_t k) const {
+       NodeBase *x = root();
+       while (x != nullptr) {
+           size_t left = Counter::of(x->left);
+           if (k < left) {
+               x = x->left;
+           } else if (k == left) {
+               return x;
+           } else {
+               k -= left + 1;
+               x = x->right;
+           }
+       }
+       return const_cast<NodeBase *>(&header);
+   }
+
+   // Number of elements in front of x; size() for the header.
+   size_t indexOf(const NodeBase *x) const {
+       if (x == &header) return sized.count;
+       size_t index = Counter::of(x->left);
+       for (; x != root(); x = x->parent()) {
+           if (x == x->parent()->right) index += Counter::of(x->parent()->left) + 1;
+       }
+       return index;
+   }
+
+   // Rotates the whole tree into a list linked through right in key order
+   // (the "vine" of Day-Stout-Warren). Parent links are left stale.
+   static NodeBase *toVine(NodeBase *node) {
+       NodeBase head;
+       NodeBase *tail = &head;
+       head.right = node;
+       while (node != nullptr) {
+           if (node->left == nullptr) {
+               tail = node;
+               node = node->right;
+           } else {
+               NodeBase *left = node->left;
+               node->left = left->right;
+               left->right = node;
+               node = left;
+               tail->right = left;
+           }
+       }
+       return head.right;
+   }
+
+   // Turns the next n nodes of the vine into a perfectly balanced subtree and
+   // advances vine past them. Subtree sizes differ by at most one at every
+   // node, so all empty leaves sit on two adjacent levels; painting the
+   // deepest (incomplete) level red and everything else black is a valid
+   // colouring.
+   static NodeBase *buildFromVine(NodeBase *&vine, size_t n, size_t depth, size_t red_depth) {
+       if (n == 0) return nullptr;
+       size_t left_n = (n - 1) / 2;
+       NodeBase *left = buildFromVine(vine, left_n, depth + 1, red_depth);
+       NodeBase *node = vine;
+       vine = vine->right;
+       node->left = left;
+       if (left != nullptr) left->setParent(node);
+       node->right = buildFromVine(vine, n - 1 - left_n, depth + 1, red_depth);
+       if (node->right != nullptr) node->right->setParent(node);
+       node->setRed((depth == red_depth));
+       Counter::pull(node);
+       return node;
+   }
+
+   // Replaces the (empty) tree by the n nodes of a sorted vine in O(n).
+   void rebuildFromVine(NodeBase *vine, size_t n) {
+       size_t red_depth = 0;
+       while ((static_cast<size_t>(2) << red_depth) <= n + 1) red_depth++;
+       setRoot(buildFromVine(vine, n, 0, red_depth));
+       sized.count = n;
+       adoptHeader();
+       if (root() != nullptr) {
+           header.left = minimum(root());
+           header.right = maximum(root());
+       }
+   }
+
+   // Builds the tree of an empty map from [first, last). As long as the keys
+   // keep increasing the nodes are only chained into a vine, which is turned
+   // into a balanced tree in O(n) at the end; duplicates are dropped like
+   // insert() would. If a key ever goes backwards, the vine built so far
+   // becomes the tree and the rest is inserted one by one. With trusted the
+   // keys are not compared at all. If an element or the comparator throws
+   // while the vine is built, the vine is dropped and the map stays empty;
+   // once the vine is the tree, the elements inserted so far stay.
+   template<class InputIt>
+   void assignRange(InputIt first, InputIt last, bool trusted) {
+       NodeBase head;
+       NodeBase *tail = &head;
+       size_t n = 0;
+       Node *z = nullptr; // created but not yet linked
+       Node *backwards = nullptr;
+       try {
+           for (; first != last; ++first) {
+               z = createNode(nullptr, *first);
+               if (!trusted && n > 0 && !comp(keyOf(tail), z->data.first)) {
+                   if (!comp(z->data.first, keyOf(tail))) {
+                       dropNode(z);
+                       z = nullptr;
+                       continue;
+                   }
+                   backwards = z;
+                   break;
+               }
+               tail->right = z;
+               tail = z;
+               z = nullptr;
+               n++;
+           }
+       } catch (...) {
+           if (z != nullptr) dropNode(z);
+           tail->right = nullptr;
+           for (NodeBase *x = head.right; x != nullptr;) {
+               NodeBase *next = x->right;
+               dropNode(x);
+               x = next;
+           }
+           throw;
+       }
+       tail->right = nullptr;
+       rebuildFromVine(head.right, n);
+       if (backwards == nullptr) return;
+       // mostly sorted input keeps paying O(1) per append
+       insertBuilt(backwards, &header);
+       for (++first; first != last; ++first) insertBuilt(createNode(nullptr, *first), &header);
+   }
+
+   // Header of the save() format: a tag, the sizes the records were written
+   // with and the number of records. Each record is the bytes of the key
+   // followed by the bytes of the mapped value.
+   static const unsigned long long SAVE_TAG = 0x31504d55544a53ULL; // "SJTUMP1"
+
+   struct SaveHeader {
+       unsigned long long tag, key_size, value_size, count;
+   };
+
+   // Input iterator over the records of a save() stream, for assignRange().
+   // Each record is read into raw storage when the iterator reaches it.
+   class StreamRecords {
+   private:
+       union Slot {
+           char raw[sizeof(value_type)];
+           value_type value;
+
+           Slot() {}
+       };
+
+       std::istream *in;
+       unsigned long long left;
+       Slot slot;
+
+       void read() {
+           in->read(reinterpret_cast<char *>(const_cast<Key *>(&slot.value.first)), sizeof(Key));
+           in->read(reinterpret_cast<char *>(&slot.value.second), sizeof(T));
+           if (!*in) throw runtime_error();
+       }
+
+   public:
+       StreamRecords() : in(nullptr), left(0) {}
+
+       StreamRecords(std::istream &is, unsigned long long n) : in(&is), left(n) {
+           if (left > 0) read();
+       }
+
+       const value_type &operator*() const {
+           return slot.value;
+       }
+
+       StreamRecords &operator++() {
+           if (--left > 0) read();
+           return *this;
+       }
+
+       bool operator!=(const StreamRecords &rhs) const {
+           return left != rhs.left;
+       }
+   };
+
+   // Drops [first, last) by flattening, unlinking the run and rebuilding the
+   // survivors, instead of a fixDelete() per erased element.
+   void eraseBulk(NodeBase *first, NodeBase *last, size_t erased) {
+       size_t kept = sized.count - erased;
+       NodeBase head;
+       head.right = toVine(root());
+       NodeBase *before = &head;
+       while (before->right != first) before = before->right;
+       NodeBase *stop = (last == &header) ? nullptr : last;
+       NodeBase *node = first;
+       while (node != stop) {
+           NodeBase *next = node->right;
+           dropNode(node);
+           node = next;
+       }
+       before->right = stop;
+       resetHeader();
+       rebuildFromVine(head.right, kept);
+   }
+
+   // Takes z out of the tree; the node itself is left to the caller.
+   void unlinkNode(NodeBase *z) {
+       NodeBase *y = z;
+       NodeBase *x;
+       NodeBase *x_parent; // x may be nullptr, so keep track of where it hangs
+       bool y_original_color = y->red();
+
+       // One node really leaves its place: z itself, or its successor when
+       // z has two children. Every ancestor of that place loses one element.
+       NodeBase *gone = (z->left == nullptr || z->right == nullptr) ? z : minimum(z->right);
+       Counter::adjust(gone->parent(), &header, static_cast<size_t>(-1));
+
+       // The leftmost node has no left child and the rightmost no right
+       // child, so their replacements are easy to find before unlinking.
+       if (z == header.left) {
+           header.left = z->right != nullptr ? minimum(z->right) : z->parent();
+       }
+       if (z == header.right) {
+           header.right = z->left != nullptr ? maximum(z->left) : z->parent();
+       }
 
        if (z->left == nullptr) {
            x = z->right;
+           x_parent = z->parent();
            transplant(z, z->right);
        } else if (z->right == nullptr) {
            x = z->left;
+           x_parent = z->parent();
            transplant(z, z->left);
        } else {
            y = minimum(z->right);
-           y_original_color = y->color;
+           y_original_color = y->red();
            x = y->right;
-           if (y->parent == z) {
-               if (x != nullptr) x->parent = y;
+           if (y->parent() == z) {
+               x_parent = y;
            } else {
+               x_parent = y->parent();
                transplant(y, y->right);
                y->right = z->right;
-               y->right->parent = y;
+               y->right->setParent(y);
            }
            transplant(z, y);
            y->left = z->left;
-           y->left->parent = y;
-           y->color = z->color;
+           y->left->setParent(y);
+           y->setRed(z->red());
+           Counter::assign(y, z);
+       }
+
+       if (!y_original_color) {
+           fixDelete(x, x_parent);
+       }
+
+       sized.count--;
+   }
+
+   void deleteNode(NodeBase *z) {
+       unlinkNode(z);
+       dropNode(z);
+   }
+
+   // Black nodes on every way from x down to an empty leaf, x included.
+   static size_t blackHeight(const NodeBase *x) {
+       size_t h = 0;
+       for (; x != nullptr; x = x->left) h += !x->red();
+       return h;
+   }
+
+   // Joins the detached trees l and r with the single node k, whose key lies
+   // between theirs, and returns the root of the result. hl and hr are the
+   // black heights of l and r, h receives that of the result, so callers
+   // that know them never measure a tree. The shorter tree is hung below the
+   // spine of the taller one where the black heights match, which touches
+   // O(|hl - hr| + 1) nodes. The header is only borrowed while fixInsert()
+   // needs a root, so this tree must be detached as well.
+   NodeBase *joinTrees(NodeBase *l, size_t hl, NodeBase *k, NodeBase *r, size_t hr, size_t &h) {
+       if (l != nullptr && l->red()) {
+           l->setRed(false);
+           hl++;
+       }
+       if (r != nullptr && r->red()) {
+           r->setRed(false);
+           hr++;
+       }
+       if (hl == hr) {
+           k->left = l;
+           k->right = r;
+           if (l != nullptr) l->setParent(k);
+           if (r != nullptr) r->setParent(k);
+           k->setRed(false);
+           Counter::pull(k);
+           h = hl + 1;
+           return k;
+       }
+       bool taller_left = hl > hr;
+       NodeBase *spot = taller_left ? l : r;
+       NodeBase *above = &header;
+       size_t tall = taller_left ? hl : hr, want = taller_left ? hr : hl, left = tall;
+       setRoot(spot);
+       spot->setParent(&header);
+       while (spot != nullptr && (spot->red() || left > want)) {
+           if (!spot->red()) left--;
+           above = spot;
+           spot = taller_left ? spot->right : spot->left;
+       }
+       NodeBase *shorter = taller_left ? r : l;
+       if (taller_left) {
+           k->left = spot;
+           k->right = shorter;
+           above->right = k;
+       } else {
+           k->left = shorter;
+           k->right = spot;
+           above->left = k;
+       }
+       if (spot != nullptr) spot->setParent(k);
+       if (shorter != nullptr) shorter->setParent(k);
+       k->setParent(above);
+       k->setRed(true);
+       for (NodeBase *x = k; x != &header; x = x->parent()) Counter::pull(x);
+       h = tall + fixInsert(k);
+       NodeBase *top = root();
+       setRoot(nullptr);
+       return top;
+   }
+
+   // Cuts the detached tree t, of black height ht, into the nodes in front
+   // of the lower_bound descent (lo) and the rest (hi), and reports their
+   // black heights. before[i] tells on which side the i-th node of that
+   // descent belongs. The heights of the subtrees follow from ht on the way
+   // down, and each join costs the difference of the heights it meets, so
+   // the joins on the way up add up to O(log n) in total.
+   void splitTree(NodeBase *t, size_t ht, const bool *before, NodeBase *&lo, size_t &hlo, NodeBase *&hi,
+                  size_t &hhi) {
+       if (t == nullptr) {
+           lo = hi = nullptr;
+           hlo = hhi = 0;
+           return;
+       }
+       NodeBase *l = t->left, *r = t->right;
+       size_t below = ht - !t->red(); // of either child
+       NodeBase *rest;
+       size_t hrest;
+       if (*before) {
+           splitTree(r, below, before + 1, rest, hrest, hi, hhi);
+           lo = joinTrees(l, below, t, rest, hrest, hlo);
+       } else {
+           splitTree(l, below, before + 1, lo, hlo, rest, hrest);
+           hi = joinTrees(rest, hrest, t, r, below, hhi);
        }
+   }
 
-       if (!y_original_color && x != nullptr) {
-           fixDelete(x);
+   // Makes the detached tree t the tree of this map, holding n elements.
+   void installTree(NodeBase *t, size_t n) {
+       resetHeader();
+       setRoot(t);
+       adoptHeader();
+       if (t != nullptr) {
+           t->setRed(false);
+           header.left = minimum(t);
+           header.right = maximum(t);
        }
+       sized.count = n;
+   }
+
+   // Element count of this map when it and other hold n together. Subtree
+   // sizes give it right away; without them both maps are walked in step
+   // until one runs out, which costs O(min(size(), other.size())).
+   size_t countApart(const map &, size_t, detail::subtree_size<true> *) const {
+       return Counter::of(root());
+   }
 
-       delete z;
-       map_size--;
+   size_t countApart(const map &other, size_t n, detail::subtree_size<false> *) const {
+       if (root() == nullptr) return 0;
+       if (other.root() == nullptr) return n;
+       const NodeBase *a = header.left, *b = other.header.left;
+       size_t steps = 1;
+       while (true) {
+           a = successor(a, &header);
+           b = successor(b, &other.header);
+           if (a == &header) return steps;
+           if (b == &other.header) return n - steps;
+           steps++;
+       }
    }
 
 public:
@@ -308,17 +1842,18 @@ public:
   *       or it = map.end(); ++end();
     */
    class const_iterator;
-   class iterator {
+   class iterator : private IteratorOwner {
    private:
-       Node *current;
-       const map *container;
+       NodeBase *current;
 
    public:
-       iterator() : current(nullptr), container(nullptr) {}
+       iterator() : IteratorOwner(), current(nullptr) {}
+
+       iterator(NodeBase *node, const map *cont) : IteratorOwner(cont), current(node) {}
 
-       iterator(Node *node, const map *cont) : current(node), container(cont) {}
+       iterator(const iterator &other) : IteratorOwner(other), current(other.current) {}
 
-       iterator(const iterator &other) : current(other.current), container(other.container) {}
+       iterator &operator=(const iterator &) = default;
 
        /**
     * TODO iter++
@@ -333,19 +1868,7 @@ public:
     * TODO ++iter
         */
        iterator &operator++() {
-           if (current == nullptr) throw invalid_iterator();
-
-           if (current->right != nullptr) {
-               current = container->minimum(current->right);
-           } else {
-               Node *parent = current->parent;
-               while (parent != nullptr && current == parent->right) {
-                   current = parent;
-                   parent = parent->parent;
-               }
-               current = parent;
-           }
-
+           current = const_cast<NodeBase *>(this->next(current));
            return *this;
        }
 
@@ -362,26 +1885,7 @@ public:
     * TODO --iter
         */
        iterator &operator--() {
-           if (current == nullptr) {
-               // --end() should give the last element
-               if (container->root == nullptr) throw invalid_iterator();
-               current = container->maximum(container->root);
-               return *this;
-           }
-
-           if (current->left != nullptr) {
-               current = container->maximum(current->left);
-           } else {
-               Node *parent = current->parent;
-               while (parent != nullptr && current == parent->left) {
-                   current = parent;
-                   parent = parent->parent;
-               }
-               current = parent;
-           }
-
-           // If we reached nullptr after decrementing from the first element, throw
-           if (current == nullptr) throw invalid_iterator();
+           current = const_cast<NodeBase *>(this->prev(current));
            return *this;
        }
 
@@ -389,16 +1893,16 @@ public:
     * a operator to check whether two iterators are same (pointing to the same memory).
         */
        value_type &operator*() const {
-           if (current == nullptr) throw invalid_iterator();
-           return current->data;
+           this->checkElement(current);
+           return static_cast<Node *>(current)->data;
        }
 
        bool operator==(const iterator &rhs) const {
-           return current == rhs.current && container == rhs.container;
+           return current == rhs.current && IteratorOwner::operator==(rhs);
        }
 
        bool operator==(const const_iterator &rhs) const {
-           return current == rhs.current && container == rhs.container;
+           return current == rhs.current && IteratorOwner::operator==(rhs);
        }
 
        /**
@@ -417,42 +1921,31 @@ public:
     * See <http://kelvinh.github.io/blog/2013/11/20/overloading-of-member-access-operator-dash-greater-than-symbol-in-cpp/> for help.
         */
        value_type *operator->() const {
-           if (current == nullptr) throw invalid_iterator();
-           return &(current->data);
+           this->checkElement(current);
+           return &(static_cast<Node *>(current)->data);
        }
 
        friend class map;
        friend class const_iterator;
    };
 
-   class const_iterator {
+   class const_iterator : private IteratorOwner {
    private:
-       const Node *current;
-       const map *container;
+       const NodeBase *current;
 
    public:
-       const_iterator() : current(nullptr), container(nullptr) {}
+       const_iterator() : IteratorOwner(), current(nullptr) {}
 
-       const_iterator(const Node *node, const map *cont) : current(node), container(cont) {}
+       const_iterator(const NodeBase *node, const map *cont) : IteratorOwner(cont), current(node) {}
 
-       const_iterator(const const_iterator &other) : current(other.current), container(other.container) {}
+       const_iterator(const const_iterator &other) : IteratorOwner(other), current(other.current) {}
 
-       const_iterator(const iterator &other) : current(other.current), container(other.container) {}
-
-       const_iterator &operator++() {
-           if (current == nullptr) throw invalid_iterator();
+       const_iterator &operator=(const const_iterator &) = default;
 
-           if (current->right != nullptr) {
-               current = container->minimum(current->right);
-           } else {
-               const Node *parent = current->parent;
-               while (parent != nullptr && current == parent->right) {
-                   current = parent;
-                   parent = parent->parent;
-               }
-               current = parent;
-           }
+       const_iterator(const iterator &other) : IteratorOwner(other), current(other.current) {}
 
+       const_iterator &operator++() {
+           current = this->next(current);
            return *this;
        }
 
@@ -463,25 +1956,7 @@ public:
        }
 
        const_iterator &operator--() {
-           if (current == nullptr) {
-               // --end() should give the last element
-               if (container->root == nullptr) throw invalid_iterator();
-               current = container->maximum(container->root);
-               return *this;
-           }
-
-           if (current->left != nullptr) {
-               current = container->maximum(current->left);
-           } else {
-               const Node *parent = current->parent;
-               while (parent != nullptr && current == parent->left) {
-                   current = parent;
-                   parent = parent->parent;
-               }
-               current = parent;
-           }
-
-           if (current == nullptr) throw invalid_iterator();
+           current = this->prev(current);
            return *this;
        }
 
@@ -492,43 +1967,176 @@ public:
        }
 
        const value_type &operator*() const {
-           if (current == nullptr) throw invalid_iterator();
-           return current->data;
+           this->checkElement(current);
+           return static_cast<const Node *>(current)->data;
        }
 
        const value_type *operator->() const {
-           if (current == nullptr) throw invalid_iterator();
-           return &(current->data);
+           this->checkElement(current);
+           return &(static_cast<const Node *>(current)->data);
        }
 
        bool operator==(const const_iterator &rhs) const {
-           return current == rhs.current && container == rhs.container;
+           return current == rhs.current && IteratorOwner::operator==(rhs);
+       }
+
+       bool operator==(const iterator &rhs) const {
+           return current == rhs.current && IteratorOwner::operator==(rhs);
+       }
+
+       bool operator!=(const const_iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       bool operator!=(const iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       friend class map;
+       friend class iterator;
+   };
+
+
+   /**
+  * owns an element taken out of a map by extract(), until it is put back into
+  *   this or another map of the same type by insert(). No element is copied
+  *   or moved on the way, the node itself changes hands.
+  *
+  * the handle keeps the memory of its node alive, also after the map it came
+  *   from is gone.
+    */
+   class node_type {
+   private:
+       Node *node;
+       typename NodePool::Group *group;
+
+       void reset() {
+           if (node != nullptr) node->~Node();
+           NodePool::drop(group);
+           node = nullptr;
+           group = nullptr;
+       }
+
+   public:
+       node_type() : node(nullptr), group(nullptr) {}
+
+       node_type(node_type &&other) noexcept : node(other.node), group(other.group) {
+           other.node = nullptr;
+           other.group = nullptr;
+       }
+
+       node_type &operator=(node_type &&other) noexcept {
+           if (this == &other) return *this;
+           reset();
+           node = other.node;
+           group = other.group;
+           other.node = nullptr;
+           other.group = nullptr;
+           return *this;
        }
 
-       bool operator==(const iterator &rhs) const {
-           return current == rhs.current && container == rhs.container;
-       }
+       node_type(const node_type &) = delete;
+
+       node_type &operator=(const node_type &) = delete;
+
+       /**
+        * destroys the element the handle still owns.
+        */
+       ~node_type() {
+           reset();
+       }
+
+       bool empty() const {
+           return node == nullptr;
+       }
+
+       explicit operator bool() const {
+           return node != nullptr;
+       }
+
+       /**
+        * the element; the handle must not be empty.
+        */
+       const Key &key() const {
+           return node->data.first;
+       }
+
+       T &mapped() const {
+           return node->data.second;
+       }
+
+       void swap(node_type &other) noexcept {
+           std::swap(node, other.node);
+           std::swap(group, other.group);
+       }
+
+       friend class map;
+   };
+
+   /**
+  * what insert(node_type &&) reports: where the element is, whether it was
+  *   inserted, and the handle back if its key was taken.
+    */
+   struct insert_return_type {
+       iterator position;
+       bool inserted;
+       node_type node;
+   };
+
+   /**
+  * TODO two constructors
+    */
+   map() {
+       resetHeader();
+   }
+
+   /**
+  * an empty map ordered by compare.
+    */
+   explicit map(const Compare &compare) : sized(typename Stats::type(compare)) {
+       resetHeader();
+   }
+
+   map(const map &other) : sized(other.comparator()) {
+       resetHeader();
+       copyFrom(other);
+   }
 
-       bool operator!=(const const_iterator &rhs) const {
-           return !(*this == rhs);
+   /**
+  * builds the map from the elements of [first, last); later duplicates are ignored.
+  * already sorted input is detected and loaded in O(n) without rebalancing.
+    */
+   template<class InputIt>
+   map(InputIt first, InputIt last) {
+       resetHeader();
+       try {
+           assignRange(first, last, false);
+       } catch (...) {
+           destroyAll();
+           throw;
        }
+   }
 
-       bool operator!=(const iterator &rhs) const {
-           return !(*this == rhs);
+   /**
+  * same for input whose keys are known to be strictly increasing: O(n), no key is compared.
+    */
+   template<class InputIt>
+   map(sorted_unique_t, InputIt first, InputIt last) {
+       resetHeader();
+       try {
+           assignRange(first, last, true);
+       } catch (...) {
+           destroyAll();
+           throw;
        }
-
-       friend class map;
-   };
-
+   }
 
    /**
-  * TODO two constructors
+  * steals the tree of other in O(1), leaving other empty.
     */
-   map() : root(nullptr), end_node(nullptr), map_size(0) {}
-
-   map(const map &other) : map_size(other.map_size) {
-       root = copy(other.root, nullptr);
-       end_node = nullptr;
+   map(map &&other) noexcept : sized(other.comparator()) {
+       resetHeader();
+       swapTree(other);
    }
 
    /**
@@ -537,19 +2145,90 @@ public:
    map &operator=(const map &other) {
        if (this == &other) return *this;
 
-       destroy(root);
+       destroyAll();
+       comparator() = other.comparator();
+       copyFrom(other);
+
+       return *this;
+   }
+
+   map &operator=(map &&other) noexcept {
+       if (this == &other) return *this;
 
-       root = copy(other.root, nullptr);
-       map_size = other.map_size;
+       destroyAll();
+       comparator() = other.comparator();
+       swapTree(other);
 
        return *this;
    }
 
+   /**
+  * replaces the contents by the elements of [first, last), see the range constructors.
+    */
+   template<class InputIt>
+   void assign(InputIt first, InputIt last) {
+       destroyAll();
+       assignRange(first, last, false);
+   }
+
+   template<class InputIt>
+   void assign(sorted_unique_t, InputIt first, InputIt last) {
+       destroyAll();
+       assignRange(first, last, true);
+   }
+
+   /**
+  * exchanges the contents with other in O(1), no element is copied or moved.
+    */
+   void swap(map &other) noexcept {
+       swapTree(other);
+       std::swap(comparator(), other.comparator());
+   }
+
+   /**
+  * writes the elements to os in key order, behind a small header.
+  * only for trivially copyable Key and T: the records are their raw bytes
+  *   (native byte order), so nothing that points elsewhere survives.
+  * throw runtime_error if os fails.
+    */
+   void save(std::ostream &os) const {
+       static_assert(__is_trivially_copyable(Key) && __is_trivially_copyable(T),
+                     "save() writes the raw bytes of Key and T");
+       SaveHeader h = {SAVE_TAG, sizeof(Key), sizeof(T), sized.count};
+       os.write(reinterpret_cast<const char *>(&h), sizeof(h));
+       for (const NodeBase *x = header.left; x != &header; x = successor(x, &header)) {
+           const value_type &data = static_cast<const Node *>(x)->data;
+           os.write(reinterpret_cast<const char *>(&data.first), sizeof(Key));
+           os.write(reinterpret_cast<const char *>(&data.second), sizeof(T));
+       }
+       if (!os) throw runtime_error();
+   }
+
+   /**
+  * replaces the contents by what save() wrote. The records come in key
+  *   order, so they are loaded in O(n) like a sorted range.
+  * throw runtime_error if the header does not match Key and T or the
+  *   stream ends early; the map is then left as it was.
+    */
+   void load(std::istream &is) {
+       static_assert(__is_trivially_copyable(Key) && __is_trivially_copyable(T),
+                     "load() reads the raw bytes of Key and T");
+       SaveHeader h;
+       is.read(reinterpret_cast<char *>(&h), sizeof(h));
+       if (!is || h.tag != SAVE_TAG || h.key_size != sizeof(Key) || h.value_size != sizeof(T)) {
+           throw runtime_error();
+       }
+       map loaded(Stats::plain(comparator()));
+       // Not trusted: a damaged file must not break the tree.
+       loaded.assignRange(StreamRecords(is, h.count), StreamRecords(), false);
+       swapTree(loaded);
+   }
+
    /**
   * TODO Destructors
     */
    ~map() {
-       destroy(root);
+       destroyNodes();
    }
 
    /**
@@ -570,6 +2249,51 @@ public:
        return node->data.second;
    }
 
+   /**
+  * at() without the exception: a pointer to the mapped value, or nullptr if
+  *   there is no element with key. For lookups that miss often.
+    */
+   T *try_at(const Key &key) {
+       Node *node = findNode(key);
+       return node != nullptr ? &node->data.second : nullptr;
+   }
+
+   const T *try_at(const Key &key) const {
+       const Node *node = findNode(key);
+       return node != nullptr ? &node->data.second : nullptr;
+   }
+
+   /**
+  * with a transparent Compare, at(), try_at(), count(), find(), lower_bound(),
+  *   upper_bound() and equal_range() also take any type the comparator can
+  *   compare with Key, so no temporary Key is built for the lookup.
+    */
+   template<class K>
+   typename detail::if_transparent<Compare, K, T &>::type at(const K &key) {
+       Node *node = findNode(key);
+       if (node == nullptr) throw index_out_of_bound();
+       return node->data.second;
+   }
+
+   template<class K>
+   typename detail::if_transparent<Compare, K, const T &>::type at(const K &key) const {
+       const Node *node = findNode(key);
+       if (node == nullptr) throw index_out_of_bound();
+       return node->data.second;
+   }
+
+   template<class K>
+   typename detail::if_transparent<Compare, K, T *>::type try_at(const K &key) {
+       Node *node = findNode(key);
+       return node != nullptr ? &node->data.second : nullptr;
+   }
+
+   template<class K>
+   typename detail::if_transparent<Compare, K, const T *>::type try_at(const K &key) const {
+       const Node *node = findNode(key);
+       return node != nullptr ? &node->data.second : nullptr;
+   }
+
    /**
   * TODO
   * access specified element
@@ -577,12 +2301,7 @@ public:
   *   performing an insertion if such key does not already exist.
     */
    T &operator[](const Key &key) {
-       Node *node = findNode(key);
-       if (node == nullptr) {
-           value_type new_pair(key, T());
-           node = insertNode(new_pair);
-       }
-       return node->data.second;
+       return tryEmplaceNode(key).first->data.second;
    }
 
    /**
@@ -596,13 +2315,11 @@ public:
   * return a iterator to the beginning
     */
    iterator begin() {
-       if (root == nullptr) return iterator(nullptr, this);
-       return iterator(minimum(root), this);
+       return iterator(header.left, this);
    }
 
    const_iterator cbegin() const {
-       if (root == nullptr) return const_iterator(nullptr, this);
-       return const_iterator(minimum(root), this);
+       return const_iterator(header.left, this);
    }
 
    /**
@@ -610,11 +2327,11 @@ public:
   * in fact, it returns past-the-end.
     */
    iterator end() {
-       return iterator(nullptr, this);
+       return iterator(&header, this);
    }
 
    const_iterator cend() const {
-       return const_iterator(nullptr, this);
+       return const_iterator(&header, this);
    }
 
    /**
@@ -622,23 +2339,70 @@ public:
   * return true if empty, otherwise false.
     */
    bool empty() const {
-       return map_size == 0;
+       return sized.count == 0;
    }
 
    /**
   * returns the number of elements.
     */
    size_t size() const {
-       return map_size;
+       return sized.count;
+   }
+
+   /**
+  * returns a copy of the comparator the keys are ordered by.
+    */
+   Compare key_comp() const {
+       return Stats::plain(comparator());
+   }
+
+   /**
+  * the counters of Policy::collect_stats (all zero without it). A copy of
+  *   the map starts counting from zero; swap() does not exchange counts.
+    */
+   map_stats stats() const {
+       return Stats::get(comparator());
+   }
+
+   void reset_stats() const {
+       Stats::reset(comparator());
    }
 
    /**
   * clears the contents
     */
    void clear() {
-       destroy(root);
-       root = nullptr;
-       map_size = 0;
+       destroyAll();
+   }
+
+   /**
+  * clear() in O(1), for maps too big to destroy at once: the tree is only
+  *   detached, and its elements are destroyed a few per later insertion
+  *   (which reuses their memory) or by reclaim(). With trivially
+  *   destructible Key and T nothing needs destroying, and this is clear(),
+  *   which frees the memory a whole chunk at a time.
+    */
+   void clear_deferred() {
+       if (TRIVIAL_NODES) {
+           destroyAll();
+           return;
+       }
+       if (root() == nullptr) return;
+       // A second tree waiting hangs off the rightmost node of this one:
+       // destroy() sees a single tree.
+       header.right->right = pool.doomed;
+       pool.doomed = root();
+       pool.doomed_count += sized.count;
+       resetHeader();
+   }
+
+   /**
+  * destroys up to n of the elements a clear_deferred() left (by default all
+  *   of them); returns how many are still waiting.
+    */
+   size_t reclaim(size_t n = static_cast<size_t>(-1)) {
+       reclaimSome(n);
+       return pool.doomed_count;
    }
 
    /**
@@ -648,28 +2412,340 @@ public:
   *   the second one is true if insert successfully, or false.
     */
    pair<iterator, bool> insert(const value_type &value) {
-       Node *node = findNode(value.first);
+       NodeBase *parent;
+       bool to_left;
+       Node *node = locate(value.first, parent, to_left);
+       if (node != nullptr) {
+           return pair<iterator, bool>(iterator(node, this), false);
+       }
+
+       node = linkNode(createNode(parent, value), parent, to_left);
+       return pair<iterator, bool>(iterator(node, this), true);
+   }
+
+   pair<iterator, bool> insert(value_type &&value) {
+       NodeBase *parent;
+       bool to_left;
+       Node *node = locate(value.first, parent, to_left);
        if (node != nullptr) {
            return pair<iterator, bool>(iterator(node, this), false);
        }
 
-       node = insertNode(value);
+       node = linkNode(createNode(parent, std::move(value)), parent, to_left);
        return pair<iterator, bool>(iterator(node, this), true);
    }
 
+   /**
+  * construct value_type(args...) in place and insert it.
+  * the return value has the same meaning as in insert().
+    */
+   template<class... Args>
+   pair<iterator, bool> emplace(Args &&...args) {
+       pair<Node *, bool> res = emplaceNode(std::forward<Args>(args)...);
+       return pair<iterator, bool>(iterator(res.first, this), res.second);
+   }
+
+   /**
+  * insert value using hint, the element that should follow it, as a starting point.
+  * when value belongs right in front of hint the insertion needs no descent,
+  *   so feeding end() while appending increasing keys is amortized O(1).
+  * return the iterator to the new element (or the element that prevented the insertion).
+  *
+  * throw invalid_iterator if hint does not belong to this.
+    */
+   iterator insert(const_iterator hint, const value_type &value) {
+       checkPosition(hint, hint.current);
+       NodeBase *parent;
+       bool to_left;
+       Node *node = locateHint(hint.current, value.first, parent, to_left);
+       if (node == nullptr) node = linkNode(createNode(parent, value), parent, to_left);
+       return iterator(node, this);
+   }
+
+   iterator insert(const_iterator hint, value_type &&value) {
+       checkPosition(hint, hint.current);
+       NodeBase *parent;
+       bool to_left;
+       Node *node = locateHint(hint.current, value.first, parent, to_left);
+       if (node == nullptr) node = linkNode(createNode(parent, std::move(value)), parent, to_left);
+       return iterator(node, this);
+   }
+
+   /**
+  * emplace() with the hint of insert(hint, value).
+    */
+   template<class... Args>
+   iterator emplace_hint(const_iterator hint, Args &&...args) {
+       checkPosition(hint, hint.current);
+       Node *z = createNode(nullptr, std::forward<Args>(args)...);
+       return iterator(insertBuilt(z, hint.current).first, this);
+   }
+
+   /**
+  * insert (key, T(args...)) if key is absent, otherwise leave the map untouched.
+  * unlike insert(), the mapped value is not constructed when the key exists.
+  * the return value has the same meaning as in insert().
+    */
+   template<class... Args>
+   pair<iterator, bool> try_emplace(const Key &key, Args &&...args) {
+       pair<Node *, bool> res = tryEmplaceNode(key, std::forward<Args>(args)...);
+       return pair<iterator, bool>(iterator(res.first, this), res.second);
+   }
+
+   template<class... Args>
+   pair<iterator, bool> try_emplace(Key &&key, Args &&...args) {
+       pair<Node *, bool> res = tryEmplaceNode(std::move(key), std::forward<Args>(args)...);
+       return pair<iterator, bool>(iterator(res.first, this), res.second);
+   }
+
+   /**
+  * assign obj to the element with key, inserting it first if it does not exist.
+  * the second of the returned pair is true if an insertion took place.
+    */
+   template<class M>
+   pair<iterator, bool> insert_or_assign(const Key &key, M &&obj) {
+       pair<Node *, bool> res = tryEmplaceNode(key, std::forward<M>(obj));
+       if (!res.second) res.first->data.second = std::forward<M>(obj);
+       return pair<iterator, bool>(iterator(res.first, this), res.second);
+   }
+
+   template<class M>
+   pair<iterator, bool> insert_or_assign(Key &&key, M &&obj) {
+       pair<Node *, bool> res = tryEmplaceNode(std::move(key), std::forward<M>(obj));
+       if (!res.second) res.first->data.second = std::forward<M>(obj);
+       return pair<iterator, bool>(iterator(res.first, this), res.second);
+   }
+
    /**
   * erase the element at pos.
   *
   * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
     */
    void erase(iterator pos) {
-       if (pos.container != this || pos.current == nullptr) {
+       if (!pos.of(this) || pos.current == nullptr || pos.current == &header) {
            throw invalid_iterator();
        }
+       pos.checkElement(pos.current);
 
        deleteNode(pos.current);
    }
 
+   /**
+  * erase the element with key, if there is one.
+  * return the number of elements removed (0 or 1).
+    */
+   size_t erase(const Key &key) {
+       Node *node = findNode(key);
+       if (node == nullptr) return 0;
+       deleteNode(node);
+       return 1;
+   }
+
+   /**
+  * erase every element in [first, last) and return last.
+  * when most of the map goes away the survivors are relinked into a fresh
+  *   balanced tree in O(size()) rather than rebalanced once per element.
+  *
+  * throw invalid_iterator if first or last does not belong to this.
+    */
+   iterator erase(const_iterator first, const_iterator last) {
+       checkPosition(first, first.current);
+       checkPosition(last, last.current);
+       NodeBase *from = const_cast<NodeBase *>(first.current);
+       NodeBase *to = const_cast<NodeBase *>(last.current);
+       if (from == header.left && to == &header) {
+           clear();
+           return end();
+       }
+
+       size_t erased = 0;
+       for (const NodeBase *x = from; x != to; x = successor(x, &header)) {
+           if (x == &header) throw invalid_iterator(); // last comes before first
+           erased++;
+       }
+       if (erased * 2 > sized.count) {
+           eraseBulk(from, to, erased);
+       } else {
+           while (from != to) {
+               NodeBase *next = const_cast<NodeBase *>(successor(from, &header));
+               deleteNode(from);
+               from = next;
+           }
+       }
+       return iterator(to, this);
+   }
+
+   /**
+  * takes the element at pos out of the map into a node handle, without
+  *   copying it. Iterators to other elements stay valid.
+  *
+  * throw invalid_iterator if pos is end() or does not belong to this.
+    */
+   node_type extract(const_iterator pos) {
+       if (!pos.of(this) || pos.current == nullptr || pos.current == &header) {
+           throw invalid_iterator();
+       }
+       pos.checkElement(pos.current);
+       node_type res;
+       res.group = pool.lend();
+       res.node = static_cast<Node *>(const_cast<NodeBase *>(pos.current));
+       unlinkNode(res.node);
+       return res;
+   }
+
+   /**
+  * the same for the element with key; an empty handle if there is none.
+    */
+   node_type extract(const Key &key) {
+       node_type res;
+       Node *x = findNode(key);
+       if (x == nullptr) return res;
+       res.group = pool.lend();
+       res.node = x;
+       unlinkNode(x);
+       return res;
+   }
+
+   /**
+  * links the element owned by node into the map unless its key is taken,
+  *   in which case node keeps it. An empty handle inserts nothing and
+  *   reports end().
+    */
+   insert_return_type insert(node_type &&node) {
+       insert_return_type res = {end(), false, node_type()};
+       if (node.empty()) return res;
+       NodeBase *parent;
+       bool to_left;
+       Node *x = locate(node.key(), parent, to_left);
+       if (x != nullptr) {
+           res.position = iterator(x, this);
+           res.node = std::move(node);
+           return res;
+       }
+       pool.adopt(node.group);
+       res.position = iterator(relinkNode(node.node, parent, to_left), this);
+       res.inserted = true;
+       node.node = nullptr;
+       node.reset();
+       return res;
+   }
+
+   /**
+  * the same with the hint of insert(hint, value); returns where the element
+  *   is. node is left empty only if its element was inserted.
+  *
+  * throw invalid_iterator if hint does not belong to this.
+    */
+   iterator insert(const_iterator hint, node_type &&node) {
+       checkPosition(hint, hint.current);
+       if (node.empty()) return end();
+       NodeBase *parent;
+       bool to_left;
+       Node *x = locateHint(hint.current, node.key(), parent, to_left);
+       if (x != nullptr) return iterator(x, this);
+       pool.adopt(node.group);
+       x = relinkNode(node.node, parent, to_left);
+       node.node = nullptr;
+       node.reset();
+       return iterator(x, this);
+   }
+
+   /**
+  * splices the elements of source whose keys are not here yet into this map;
+  *   the others stay in source. Same as join(): disjoint key ranges are joined
+  *   in O(log n), otherwise nodes are relinked one by one. Nothing is copied
+  *   or reallocated either way.
+    */
+   void merge(map &source) {
+       join(source);
+   }
+
+   void merge(map &&source) {
+       join(source);
+   }
+
+   /**
+  * moves the elements whose keys are not less than key into a new map, which is
+  *   returned; the smaller ones stay. No element is copied or reallocated:
+  *   the tree is cut along one search path in O(log n). The sizes of the two
+  *   halves come from the subtree sizes with Policy::order_statistics, which
+  *   makes the whole split O(log n); without them both halves are walked in
+  *   step until one ends, so the split costs O(log n + min of the two sizes).
+  *
+  * afterwards both maps may hold nodes from memory the other one allocated, so
+  *   it is returned only once all maps that took part in the split or a later
+  *   join are cleared or destroyed. Those maps should not be cleared or
+  *   destroyed by different threads at the same time.
+  * iterators to elements that moved are invalidated.
+    */
+   map split(const Key &key) {
+       map result;
+       result.comparator() = comparator();
+       bool before[MAX_HEIGHT];
+       size_t depth = 0;
+       for (NodeBase *x = root(); x != nullptr; depth++) {
+           before[depth] = comp(keyOf(x), key);
+           x = before[depth] ? x->right : x->left;
+       }
+       pool.share(result.pool);
+       size_t n = sized.count;
+       NodeBase *t = root(), *lo, *hi;
+       size_t hlo, hhi;
+       resetHeader();
+       splitTree(t, blackHeight(t), before, lo, hlo, hi, hhi);
+       installTree(lo, 0);
+       result.installTree(hi, 0);
+       sized.count = countApart(result, n, static_cast<Counter *>(nullptr));
+       result.sized.count = n - sized.count;
+       return result;
+   }
+
+   /**
+  * moves every element of other into this map, leaving other empty. When all
+  *   keys of other are greater than those here (or all smaller) the trees are
+  *   joined in O(log n + log other.size()) without copying or reallocating a
+  *   single element, see split() for the memory that is shared afterwards.
+  * otherwise the nodes are relinked one at a time in O(other.size() log n),
+  *   and like insert() the elements whose keys are here already stay in other.
+  * iterators into other are invalidated.
+    */
+   void join(map &other) {
+       if (&other == this || other.root() == nullptr) return;
+       if (root() == nullptr) {
+           swapTree(other);
+           return;
+       }
+       bool other_above = comp(keyOf(header.right), keyOf(other.header.left));
+       bool other_below = !other_above && comp(keyOf(other.header.right), keyOf(header.left));
+       pool.share(other.pool);
+       if (!other_above && !other_below) {
+           for (NodeBase *x = other.header.left; x != &other.header;) {
+               NodeBase *next = const_cast<NodeBase *>(successor(x, &other.header));
+               NodeBase *parent;
+               bool to_left;
+               if (locate(keyOf(x), parent, to_left) == nullptr) {
+                   other.unlinkNode(x);
+                   relinkNode(x, parent, to_left);
+               }
+               x = next;
+           }
+           if (other.sized.count == 0) other.destroyAll();
+           return;
+       }
+       size_t n = sized.count + other.sized.count;
+       // the pivot is the element next to the gap between the two key ranges
+       NodeBase *pivot = other_above ? other.header.left : other.header.right;
+       other.unlinkNode(pivot);
+       NodeBase *mine = root(), *theirs = other.root();
+       size_t hm = blackHeight(mine), ht = blackHeight(theirs), h;
+       resetHeader();
+       other.resetHeader();
+       other.destroyAll();
+       installTree(other_above ? joinTrees(mine, hm, pivot, theirs, ht, h)
+                               : joinTrees(theirs, ht, pivot, mine, hm, h),
+                   n);
+   }
+
    /**
   * Returns the number of elements with key
   *   that compares equivalent to the specified argument,
@@ -681,6 +2757,11 @@ public:
        return findNode(key) != nullptr ? 1 : 0;
    }
 
+   template<class K>
+   typename detail::if_transparent<Compare, K, size_t>::type count(const K &key) const {
+       return findNode(key) != nullptr ? 1 : 0;
+   }
+
    /**
   * Finds an element with key equivalent to key.
   * key value of the element to search for.
@@ -698,8 +2779,180 @@ public:
        if (node == nullptr) return cend();
        return const_iterator(node, this);
    }
+
+   template<class K>
+   typename detail::if_transparent<Compare, K, iterator>::type find(const K &key) {
+       Node *node = findNode(key);
+       if (node == nullptr) return end();
+       return iterator(node, this);
+   }
+
+   template<class K>
+   typename detail::if_transparent<Compare, K, const_iterator>::type find(const K &key) const {
+       const Node *node = findNode(key);
+       if (node == nullptr) return cend();
+       return const_iterator(node, this);
+   }
+
+   /**
+  * find() for every key of [first, last): writes the iterators to out in the
+  *   same order and returns out past the last one.
+  * up to eight searches run interleaved and prefetch ahead, so their cache
+  *   misses overlap; if the keys are sorted, each one also starts from the
+  *   path of the previous one instead of the root. The keys are read in
+  *   blocks of 256, *first must be a Key lvalue.
+    */
+   template<class ForwardIt, class OutputIt>
+   OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out) {
+       findEach(first, last, [&](NodeBase *x) {
+           *out++ = x != nullptr ? iterator(x, this) : end();
+       });
+       return out;
+   }
+
+   template<class ForwardIt, class OutputIt>
+   OutputIt find_batch(ForwardIt first, ForwardIt last, OutputIt out) const {
+       findEach(first, last, [&](const NodeBase *x) {
+           *out++ = x != nullptr ? const_iterator(x, this) : cend();
+       });
+       return out;
+   }
+
+   /**
+  * the same for count(): writes 1 or 0 per key and returns how many were found.
+    */
+   template<class ForwardIt, class OutputIt>
+   size_t count_batch(ForwardIt first, ForwardIt last, OutputIt out) const {
+       size_t total = 0;
+       findEach(first, last, [&](const NodeBase *x) {
+           size_t c = x != nullptr ? 1 : 0;
+           *out++ = c;
+           total += c;
+       });
+       return total;
+   }
+
+   /**
+  * return an iterator to the first element whose key is not less than key,
+  *   or end() if there is none.
+    */
+   iterator lower_bound(const Key &key) {
+       return iterator(lowerBound(key), this);
+   }
+
+   const_iterator lower_bound(const Key &key) const {
+       return const_iterator(lowerBound(key), this);
+   }
+
+   template<class K>
+   typename detail::if_transparent<Compare, K, iterator>::type lower_bound(const K &key) {
+       return iterator(lowerBound(key), this);
+   }
+
+   template<class K>
+   typename detail::if_transparent<Compare, K, const_iterator>::type lower_bound(const K &key) const {
+       return const_iterator(lowerBound(key), this);
+   }
+
+   /**
+  * return an iterator to the first element whose key is greater than key,
+  *   or end() if there is none.
+    */
+   iterator upper_bound(const Key &key) {
+       return iterator(upperBound(key), this);
+   }
+
+   const_iterator upper_bound(const Key &key) const {
+       return const_iterator(upperBound(key), this);
+   }
+
+   template<class K>
+   typename detail::if_transparent<Compare, K, iterator>::type upper_bound(const K &key) {
+       return iterator(upperBound(key), this);
+   }
+
+   template<class K>
+   typename detail::if_transparent<Compare, K, const_iterator>::type upper_bound(const K &key) const {
+       return const_iterator(upperBound(key), this);
+   }
+
+   /**
+  * the following need Policy::order_statistics (see order_statistics_policy)
+  *   and run in O(log n).
+  *
+  * nth(k) returns the element with exactly k smaller keys, or end() if k >= size().
+    */
+   iterator nth(size_t k) {
+       static_assert(Policy::order_statistics, "nth() needs Policy::order_statistics");
+       return iterator(nthNode(k), this);
+   }
+
+   const_iterator nth(size_t k) const {
+       static_assert(Policy::order_statistics, "nth() needs Policy::order_statistics");
+       return const_iterator(nthNode(k), this);
+   }
+
+   /**
+  * number of elements whose key is less than key.
+    */
+   size_t rank(const Key &key) const {
+       static_assert(Policy::order_statistics, "rank() needs Policy::order_statistics");
+       return indexOf(lowerBound(key));
+   }
+
+   /**
+  * number of increments needed to get from first to last; first must not be after last.
+  * throw invalid_iterator if either iterator does not belong to this.
+    */
+   size_t distance(const_iterator first, const_iterator last) const {
+       static_assert(Policy::order_statistics, "distance() needs Policy::order_statistics");
+       checkPosition(first, first.current);
+       checkPosition(last, last.current);
+       size_t from = indexOf(first.current), to = indexOf(last.current);
+       if (from > to) throw invalid_iterator();
+       return to - from;
+   }
+
+   /**
+  * return [lower_bound(key), upper_bound(key)), holding at most one element.
+    */
+   pair<iterator, iterator> equal_range(const Key &key) {
+       NodeBase *lo = lowerBound(key);
+       NodeBase *hi = lo;
+       if (lo != &header && !comp(key, keyOf(lo))) hi = const_cast<NodeBase *>(successor(lo, &header));
+       return pair<iterator, iterator>(iterator(lo, this), iterator(hi, this));
+   }
+
+   pair<const_iterator, const_iterator> equal_range(const Key &key) const {
+       NodeBase *lo = lowerBound(key);
+       const NodeBase *hi = lo;
+       if (lo != &header && !comp(key, keyOf(lo))) hi = successor(lo, &header);
+       return pair<const_iterator, const_iterator>(const_iterator(lo, this), const_iterator(hi, this));
+   }
+
+   template<class K>
+   typename detail::if_transparent<Compare, K, pair<iterator, iterator> >::type equal_range(const K &key) {
+       NodeBase *lo = lowerBound(key);
+       NodeBase *hi = lo;
+       if (lo != &header && !comp(key, keyOf(lo))) hi = const_cast<NodeBase *>(successor(lo, &header));
+       return pair<iterator, iterator>(iterator(lo, this), iterator(hi, this));
+   }
+
+   template<class K>
+   typename detail::if_transparent<Compare, K, pair<const_iterator, const_iterator> >::type
+   equal_range(const K &key) const {
+       NodeBase *lo = lowerBound(key);
+       const NodeBase *hi = lo;
+       if (lo != &header && !comp(key, keyOf(lo))) hi = successor(lo, &header);
+       return pair<const_iterator, const_iterator>(const_iterator(lo, this), const_iterator(hi, this));
+   }
 };
 
+template<class Key, class T, class Compare, class Policy>
+void swap(map<Key, T, Compare, Policy> &lhs, map<Key, T, Compare, Policy> &rhs) noexcept {
+   lhs.swap(rhs);
+}
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,220 @@
+/**
+* a relocatable on-disk image of a frozen_map, queried where it lies
+*/
+#ifndef SJTU_MAP_IMAGE_HPP
+#define SJTU_MAP_IMAGE_HPP
+
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <type_traits>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "map.hpp"
+#include "frozen_map.hpp"
+
+namespace sjtu {
+
+namespace detail {
+
+// The header at the start of an image. Every offset counts from the start
+// of the image and nothing in it is a pointer, so the bytes can be mapped
+// at any address. Keys and values follow as the two slot arrays of a
+// frozen_map (slot 0 included and zeroed), each starting at a multiple of
+// IMAGE_ALIGN.
+struct image_header {
+   char magic[8];
+   std::uint64_t version;
+   std::uint64_t key_size, key_align;
+   std::uint64_t value_size, value_align;
+   std::uint64_t count;
+   std::uint64_t keys_offset, values_offset, total_size;
+};
+
+static const char IMAGE_MAGIC[8] = {'S', 'J', 'T', 'U', 'I', 'M', 'G', '\0'};
+static const std::uint64_t IMAGE_VERSION = 1;
+static const std::uint64_t IMAGE_ALIGN = 64;
+
+inline std::uint64_t imageRoundUp(std::uint64_t n) {
+   return (n + IMAGE_ALIGN - 1) / IMAGE_ALIGN * IMAGE_ALIGN;
+}
+
+// Whether slots elements of elem bytes starting at offset lie inside size
+// bytes, without overflowing on a damaged header.
+inline bool imageFits(std::uint64_t offset, std::uint64_t slots, std::uint64_t elem, std::uint64_t size) {
+   return offset <= size && slots <= (size - offset) / elem;
+}
+
+inline void imagePad(std::ostream &os, std::uint64_t n) {
+   static const char zeros[IMAGE_ALIGN] = {};
+   while (n > 0) {
+       std::uint64_t step = n < IMAGE_ALIGN ? n : IMAGE_ALIGN;
+       os.write(zeros, static_cast<std::streamsize>(step));
+       n -= step;
+   }
+}
+
+struct image_access {
+   template<class Key, class T, class Compare>
+   static void write(std::ostream &os, const frozen_map<Key, T, Compare> &m) {
+       std::uint64_t slots = static_cast<std::uint64_t>(m.length) + 1;
+       image_header h;
+       std::memcpy(h.magic, IMAGE_MAGIC, sizeof(h.magic));
+       h.version = IMAGE_VERSION;
+       h.key_size = sizeof(Key);
+       h.key_align = alignof(Key);
+       h.value_size = sizeof(T);
+       h.value_align = alignof(T);
+       h.count = m.length;
+       h.keys_offset = imageRoundUp(sizeof(image_header));
+       h.values_offset = imageRoundUp(h.keys_offset + slots * sizeof(Key));
+       h.total_size = h.values_offset + slots * sizeof(T);
+
+       os.write(reinterpret_cast<const char *>(&h), sizeof(h));
+       imagePad(os, h.keys_offset - sizeof(h) + sizeof(Key));
+       if (m.length > 0) {
+           os.write(reinterpret_cast<const char *>(m.keys + 1), static_cast<std::streamsize>(m.length * sizeof(Key)));
+       }
+       imagePad(os, h.values_offset - (h.keys_offset + slots * sizeof(Key)) + sizeof(T));
+       if (m.length > 0) {
+           os.write(reinterpret_cast<const char *>(m.values + 1), static_cast<std::streamsize>(m.length * sizeof(T)));
+       }
+       if (!os) throw runtime_error();
+   }
+};
+
+}
+
+/**
+* writes m to os as an image that map_image can query in place.
+* only for trivially copyable Key and T; the image keeps the native byte
+*   order and must be read with the same Compare.
+* throw runtime_error if os fails.
+*/
+template<class Key, class T, class Compare>
+void write_image(std::ostream &os, const frozen_map<Key, T, Compare> &m) {
+   static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<T>::value,
+                 "an image holds the raw bytes of Key and T");
+   detail::image_access::write(os, m);
+}
+
+/**
+* the same for a map, which is frozen first.
+*/
+template<class Key, class T, class Compare, class Policy>
+void write_image(std::ostream &os, const map<Key, T, Compare, Policy> &m) {
+   write_image(os, frozen_map<Key, T, Compare>(m));
+}
+
+/**
+* the frozen_map stored in an image, read straight from its bytes.
+*
+* opening an image only checks its header: no element is copied and nothing
+*   is allocated, so a memory mapped image of any size is ready at once and
+*   its pages are loaded as lookups touch them. The interface is the one of
+*   frozen_map. The bytes must stay valid and unchanged while the map_image
+*   and its iterators are in use.
+*/
+template<
+   class Key,
+   class T,
+   class Compare = std::less <Key>
+   > class map_image : public detail::eytzinger_view<Key, T, Compare> {
+   static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<T>::value,
+                 "an image holds the raw bytes of Key and T");
+
+public:
+   /**
+  * an image of size bytes at data, written by write_image().
+  * throw runtime_error if the header is damaged, was written for other key
+  *   or value types, or does not fit into size bytes.
+    */
+   map_image(const void *data, size_t size) {
+       const char *base = static_cast<const char *>(data);
+       detail::image_header h;
+       if (size < sizeof(h)) throw runtime_error();
+       std::memcpy(&h, base, sizeof(h));
+       if (std::memcmp(h.magic, detail::IMAGE_MAGIC, sizeof(h.magic)) != 0 || h.version != detail::IMAGE_VERSION ||
+           h.key_size != sizeof(Key) || h.key_align != alignof(Key) ||
+           h.value_size != sizeof(T) || h.value_align != alignof(T) ||
+           h.total_size > size || h.count >= h.total_size ||
+           !detail::imageFits(h.keys_offset, h.count + 1, sizeof(Key), h.total_size) ||
+           !detail::imageFits(h.values_offset, h.count + 1, sizeof(T), h.total_size)) {
+           throw runtime_error();
+       }
+       const char *k = base + h.keys_offset;
+       const char *v = base + h.values_offset;
+       if (reinterpret_cast<std::uintptr_t>(k) % alignof(Key) != 0 ||
+           reinterpret_cast<std::uintptr_t>(v) % alignof(T) != 0) {
+           throw runtime_error();
+       }
+       this->keys = reinterpret_cast<const Key *>(k);
+       this->values = reinterpret_cast<const T *>(v);
+       this->length = static_cast<size_t>(h.count);
+   }
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+/**
+* a file mapped read-only into memory, e.g. to open a map_image on it:
+*     mapped_file file("index.img");
+*     map_image<long, double> index(file.data(), file.size());
+*/
+class mapped_file {
+private:
+   void *addr;
+   size_t length;
+
+public:
+   /**
+  * throw runtime_error if the file cannot be opened or mapped.
+    */
+   explicit mapped_file(const char *path) : addr(nullptr), length(0) {
+       int fd = ::open(path, O_RDONLY);
+       if (fd < 0) throw runtime_error();
+       struct stat st;
+       if (::fstat(fd, &st) != 0) {
+           ::close(fd);
+           throw runtime_error();
+       }
+       length = static_cast<size_t>(st.st_size);
+       if (length > 0) {
+           void *p = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+           if (p == MAP_FAILED) {
+               ::close(fd);
+               throw runtime_error();
+           }
+           addr = p;
+       }
+       ::close(fd);
+   }
+
+   mapped_file(const mapped_file &) = delete;
+
+   mapped_file &operator=(const mapped_file &) = delete;
+
+   ~mapped_file() {
+       if (addr != nullptr) ::munmap(addr, length);
+   }
+
+   const void *data() const {
+       return addr;
+   }
+
+   size_t size() const {
+       return length;
+   }
+};
+#endif
+
+}
+
+#endif
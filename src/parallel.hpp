@@ -0,0 +1,572 @@
+/**
+* parallel bulk operations on sjtu::map
+*/
+#ifndef SJTU_PARALLEL_HPP
+#define SJTU_PARALLEL_HPP
+
+#include <functional>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+* a small work stealing thread pool.
+*
+* every worker owns a task deque: it pushes and pops at the back, idle workers
+*   steal from the front of the others. Threads outside the pool share one
+*   more deque. A task_group waiting for its tasks runs queued tasks itself, so
+*   tasks may fork and wait for subtasks without tying up a worker.
+*/
+class thread_pool {
+public:
+   typedef std::function<void()> task;
+
+private:
+   struct Queue {
+       std::mutex lock;
+       std::deque<task> tasks;
+   };
+
+   std::vector<std::thread> threads;
+   std::vector<Queue *> queues; // one per worker, then the one for outside threads
+   std::atomic<bool> stopping;
+   std::atomic<size_t> queued;
+   std::mutex idle_lock;
+   std::condition_variable idle;
+
+   struct Self {
+       const thread_pool *pool;
+       size_t index;
+   };
+
+   static Self &self() {
+       static thread_local Self s = {nullptr, 0};
+       return s;
+   }
+
+   size_t selfIndex() const {
+       return self().pool == this ? self().index : queues.size() - 1;
+   }
+
+   bool popBack(size_t i, task &t) {
+       std::lock_guard<std::mutex> guard(queues[i]->lock);
+       if (queues[i]->tasks.empty()) return false;
+       t = std::move(queues[i]->tasks.back());
+       queues[i]->tasks.pop_back();
+       return true;
+   }
+
+   bool stealFront(size_t i, task &t) {
+       std::lock_guard<std::mutex> guard(queues[i]->lock);
+       if (queues[i]->tasks.empty()) return false;
+       t = std::move(queues[i]->tasks.front());
+       queues[i]->tasks.pop_front();
+       return true;
+   }
+
+   void work(size_t index) {
+       self().pool = this;
+       self().index = index;
+       while (!stopping.load()) {
+           if (runOne()) continue;
+           std::unique_lock<std::mutex> guard(idle_lock);
+           idle.wait(guard, [this] { return stopping.load() || queued.load() != 0; });
+       }
+   }
+
+   void shutdown() {
+       {
+           std::lock_guard<std::mutex> guard(idle_lock);
+           stopping.store(true);
+       }
+       idle.notify_all();
+       for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+       threads.clear();
+       for (size_t i = 0; i < queues.size(); ++i) delete queues[i];
+       queues.clear();
+   }
+
+public:
+   /**
+    * threads is the total parallelism, the thread that waits included;
+    *   0 means one per hardware thread.
+    */
+   explicit thread_pool(size_t threads_ = 0) : stopping(false), queued(0) {
+       if (threads_ == 0) threads_ = std::thread::hardware_concurrency();
+       if (threads_ == 0) threads_ = 1;
+       for (size_t i = 0; i < threads_; ++i) queues.push_back(new Queue);
+       try {
+           for (size_t i = 0; i + 1 < threads_; ++i) threads.push_back(std::thread(&thread_pool::work, this, i));
+       } catch (...) {
+           shutdown();
+           throw;
+       }
+   }
+
+   thread_pool(const thread_pool &) = delete;
+
+   thread_pool &operator=(const thread_pool &) = delete;
+
+   ~thread_pool() {
+       shutdown();
+   }
+
+   /**
+    * the number of threads that run tasks, counting the one that waits.
+    */
+   size_t size() const {
+       return queues.size();
+   }
+
+   void submit(task t) {
+       size_t i = selfIndex();
+       queued.fetch_add(1);
+       try {
+           std::lock_guard<std::mutex> guard(queues[i]->lock);
+           queues[i]->tasks.push_back(std::move(t));
+       } catch (...) {
+           queued.fetch_sub(1);
+           throw;
+       }
+       {
+           std::lock_guard<std::mutex> guard(idle_lock);
+       }
+       idle.notify_one();
+   }
+
+   /**
+    * runs one queued task on the calling thread, its own deque first;
+    *   false if there was none.
+    */
+   bool runOne() {
+       size_t i = selfIndex();
+       task t;
+       bool found = popBack(i, t);
+       for (size_t k = 1; !found && k < queues.size(); ++k) found = stealFront((i + k) % queues.size(), t);
+       if (!found) return false;
+       queued.fetch_sub(1);
+       t();
+       return true;
+   }
+};
+
+/**
+* the pool used when none is passed: one thread per hardware thread.
+*/
+inline thread_pool &default_pool() {
+   static thread_pool pool;
+   return pool;
+}
+
+/**
+* fork-join on a thread_pool: run() queues tasks, wait() returns once they
+*   all finished and rethrows the first exception one of them threw.
+*/
+class task_group {
+private:
+   thread_pool &pool;
+   std::atomic<size_t> pending;
+   std::mutex error_lock;
+   std::exception_ptr error;
+
+public:
+   explicit task_group(thread_pool &p) : pool(p), pending(0) {}
+
+   task_group(const task_group &) = delete;
+
+   task_group &operator=(const task_group &) = delete;
+
+   ~task_group() {
+       while (pending.load() != 0) {
+           if (!pool.runOne()) std::this_thread::yield();
+       }
+   }
+
+   template<class F>
+   void run(F f) {
+       pending.fetch_add(1);
+       try {
+           pool.submit([this, f]() {
+               try {
+                   f();
+               } catch (...) {
+                   std::lock_guard<std::mutex> guard(error_lock);
+                   if (!error) error = std::current_exception();
+               }
+               pending.fetch_sub(1);
+           });
+       } catch (...) {
+           pending.fetch_sub(1);
+           throw;
+       }
+   }
+
+   void wait() {
+       while (pending.load() != 0) {
+           if (!pool.runOne()) std::this_thread::yield();
+       }
+       if (error) {
+           std::exception_ptr e = error;
+           error = nullptr;
+           std::rethrow_exception(e);
+       }
+   }
+};
+
+namespace detail {
+
+// Sections of a sequence handed to separate tasks are at least this long.
+const size_t PARALLEL_GRAIN = 4096;
+
+// A stable merge of [a, a + na) and [b, b + nb) puts the first d outputs
+// together from the first i elements of a and the first d - i of b; this is i.
+template<class P, class Less>
+size_t merge_split(const P *a, size_t na, const P *b, size_t nb, size_t d, const Less &less) {
+   size_t lo = d > nb ? d - nb : 0, hi = d < na ? d : na;
+   while (lo < hi) {
+       size_t mid = (lo + hi) / 2;
+       if (!less(b[d - mid - 1], a[mid])) {
+           lo = mid + 1;
+       } else {
+           hi = mid;
+       }
+   }
+   return lo;
+}
+
+// Stable merge (a first among equals) cut into equal output sections along
+// the merge path, one task each.
+template<class P, class Less>
+void parallel_merge(const P *a, size_t na, const P *b, size_t nb, P *out, const Less &less, thread_pool &pool) {
+   size_t n = na + nb;
+   size_t parts = std::min(pool.size() * 4, n / PARALLEL_GRAIN + 1);
+   task_group group(pool);
+   for (size_t p = 0; p < parts; ++p) {
+       group.run([=, &less] {
+           size_t d0 = n * p / parts, d1 = n * (p + 1) / parts;
+           size_t i0 = merge_split(a, na, b, nb, d0, less), i1 = merge_split(a, na, b, nb, d1, less);
+           std::merge(a + i0, a + i1, b + (d0 - i0), b + (d1 - i1), out + d0, less);
+       });
+   }
+   group.wait();
+}
+
+// Stable merge sort; halves are sorted by separate tasks, then merged in parallel.
+template<class P, class Less>
+void parallel_sort(P *first, P *buffer, size_t n, const Less &less, thread_pool &pool, size_t depth) {
+   if (depth == 0 || n <= PARALLEL_GRAIN) {
+       std::stable_sort(first, first + n, less);
+       return;
+   }
+   size_t half = n / 2;
+   {
+       task_group group(pool);
+       group.run([=, &less, &pool] { parallel_sort(first, buffer, half, less, pool, depth - 1); });
+       parallel_sort(first + half, buffer + half, n - half, less, pool, depth - 1);
+       group.wait();
+   }
+   parallel_merge(first, half, first + half, n - half, buffer, less, pool);
+   std::copy(buffer, buffer + n, first);
+}
+
+// Copies the elements of [in, in + n) for which keep(in, n, k) holds to out,
+// in order, with one task per section; returns how many were kept.
+template<class P, class Keep>
+size_t parallel_filter(const P *in, size_t n, P *out, const Keep &keep, thread_pool &pool) {
+   size_t parts = std::min(pool.size() * 4, n / PARALLEL_GRAIN + 1);
+   std::vector<size_t> kept(parts + 1, 0);
+   {
+       task_group group(pool);
+       for (size_t p = 0; p < parts; ++p) {
+           group.run([=, &keep, &kept] {
+               size_t c = 0;
+               for (size_t k = n * p / parts; k < n * (p + 1) / parts; ++k) c += keep(in, n, k);
+               kept[p + 1] = c;
+           });
+       }
+       group.wait();
+   }
+   for (size_t p = 0; p < parts; ++p) kept[p + 1] += kept[p];
+   task_group group(pool);
+   for (size_t p = 0; p < parts; ++p) {
+       group.run([=, &keep, &kept] {
+           P *to = out + kept[p];
+           for (size_t k = n * p / parts; k < n * (p + 1) / parts; ++k) {
+               if (keep(in, n, k)) *to++ = in[k];
+           }
+       });
+   }
+   group.wait();
+   return kept[parts];
+}
+
+// Input iterator over the elements behind an array of pointers.
+template<class V>
+class deref_iterator {
+private:
+   V *const *at;
+
+public:
+   explicit deref_iterator(V *const *p) : at(p) {}
+
+   V &operator*() const {
+       return **at;
+   }
+
+   V *operator->() const {
+       return *at;
+   }
+
+   deref_iterator &operator++() {
+       ++at;
+       return *this;
+   }
+
+   bool operator==(const deref_iterator &rhs) const {
+       return at == rhs.at;
+   }
+
+   bool operator!=(const deref_iterator &rhs) const {
+       return at != rhs.at;
+   }
+};
+
+// The comparator a map type was instantiated with.
+template<class Map>
+struct compare_of;
+
+template<class Key, class T, class Compare, class Policy>
+struct compare_of<map<Key, T, Compare, Policy> > {
+   typedef Compare type;
+};
+
+// Orders pointers to elements by their keys.
+template<class V, class Compare>
+struct key_less {
+   Compare comp;
+
+   bool operator()(const V *a, const V *b) const {
+       return comp(a->first, b->first);
+   }
+};
+
+// Tree walks for the algorithms below. The top levels of a tree are cut into
+// pieces, single nodes and whole subtrees, that cover it in key order;
+// subtrees go to separate tasks.
+struct map_access {
+   template<class Map>
+   struct piece {
+       typename Map::NodeBase *node;
+       bool subtree;
+   };
+
+   template<class Map>
+   static typename Map::value_type &value(typename Map::NodeBase *x) {
+       return static_cast<typename Map::Node *>(x)->data;
+   }
+
+   template<class Map>
+   static void cut(typename Map::NodeBase *x, size_t levels, std::vector<piece<Map> > &out) {
+       if (x == nullptr) return;
+       piece<Map> p = {x, levels == 0};
+       if (levels == 0) {
+           out.push_back(p);
+           return;
+       }
+       cut<Map>(x->left, levels - 1, out);
+       out.push_back(p);
+       cut<Map>(x->right, levels - 1, out);
+   }
+
+   template<class Map>
+   static std::vector<piece<Map> > pieces(const Map &m, thread_pool &pool) {
+       size_t levels = 0;
+       while ((static_cast<size_t>(1) << levels) < pool.size() * 8 && levels < 16) ++levels;
+       std::vector<piece<Map> > out;
+       cut<Map>(m.root(), pool.size() > 1 ? levels : 0, out);
+       return out;
+   }
+
+   // In-order walk of the subtree at x; the depth is that of a balanced tree.
+   template<class Map, class F>
+   static void inorder(typename Map::NodeBase *x, F &f) {
+       while (x != nullptr) {
+           inorder<Map>(x->left, f);
+           f(x);
+           x = x->right;
+       }
+   }
+
+   template<class Map, class F>
+   static void for_each(Map &m, F &f, thread_pool &pool) {
+       std::vector<piece<Map> > ps = pieces(m, pool);
+       auto call = [&f](typename Map::NodeBase *x) { f(value<Map>(x)); };
+       task_group group(pool);
+       for (size_t i = 0; i < ps.size(); ++i) {
+           if (!ps[i].subtree) continue;
+           typename Map::NodeBase *x = ps[i].node;
+           group.run([x, &call] { inorder<Map>(x, call); });
+       }
+       for (size_t i = 0; i < ps.size(); ++i) {
+           if (!ps[i].subtree) call(ps[i].node);
+       }
+       group.wait();
+   }
+
+   // Pointers to all elements of m in key order: the pieces are sized in
+   // parallel, then every subtree fills its own section.
+   template<class Map>
+   static std::vector<const typename Map::value_type *> flatten(const Map &m, thread_pool &pool) {
+       typedef const typename Map::value_type *pointer;
+       std::vector<piece<Map> > ps = pieces(m, pool);
+       std::vector<size_t> offset(ps.size() + 1, 0);
+       {
+           task_group group(pool);
+           for (size_t i = 0; i < ps.size(); ++i) {
+               if (!ps[i].subtree) {
+                   offset[i + 1] = 1;
+                   continue;
+               }
+               typename Map::NodeBase *x = ps[i].node;
+               size_t *slot = &offset[i + 1];
+               group.run([x, slot] {
+                   size_t c = 0;
+                   auto count = [&c](typename Map::NodeBase *) { ++c; };
+                   inorder<Map>(x, count);
+                   *slot = c;
+               });
+           }
+           group.wait();
+       }
+       for (size_t i = 0; i < ps.size(); ++i) offset[i + 1] += offset[i];
+       std::vector<pointer> out(offset[ps.size()]);
+       task_group group(pool);
+       for (size_t i = 0; i < ps.size(); ++i) {
+           typename Map::NodeBase *x = ps[i].node;
+           pointer *to = out.data() + offset[i];
+           if (!ps[i].subtree) {
+               *to = &value<Map>(x);
+               continue;
+           }
+           group.run([x, to] {
+               pointer *at = to;
+               auto put = [&at](typename Map::NodeBase *y) { *at++ = &value<Map>(y); };
+               inorder<Map>(x, put);
+           });
+       }
+       group.wait();
+       return out;
+   }
+};
+
+}
+
+/**
+* calls f(value) for every element of m, on the threads of pool.
+*
+* the calls for different elements run concurrently and in no particular
+*   order, so f must be safe to call like that; f may change the mapped values
+*   but not the keys or the map. The first exception f throws is rethrown
+*   once all tasks are done.
+*/
+template<class Key, class T, class Compare, class Policy, class F>
+void parallel_for_each(map<Key, T, Compare, Policy> &m, F f, thread_pool &pool = default_pool()) {
+   detail::map_access::for_each(m, f, pool);
+}
+
+/**
+* builds a map ordered by comp from [first, last) in any order: the elements
+*   are sorted on the threads of pool, then loaded by the linear sorted build.
+*   Of equal keys the first one wins, as with insert().
+*/
+template<class Map, class InputIt>
+Map parallel_build(InputIt first, InputIt last, const typename detail::compare_of<Map>::type &comp,
+                   thread_pool &pool = default_pool()) {
+   typedef const typename Map::value_type *pointer;
+   std::vector<typename Map::value_type> staged(first, last);
+   size_t n = staged.size();
+   std::vector<pointer> order(n), buffer(n);
+   for (size_t i = 0; i < n; ++i) order[i] = &staged[i];
+   typedef typename detail::compare_of<Map>::type Compare;
+   detail::key_less<const typename Map::value_type, Compare> less = {comp};
+   size_t depth = 0;
+   while ((static_cast<size_t>(1) << depth) < pool.size() * 2) ++depth;
+   detail::parallel_sort(order.data(), buffer.data(), n, less, pool, depth);
+   // stable sorting keeps the first of equal keys in front
+   size_t kept = detail::parallel_filter(order.data(), n, buffer.data(), [&less](const pointer *in, size_t, size_t k) {
+       return k == 0 || less(in[k - 1], in[k]);
+   }, pool);
+   Map result(comp);
+   result.assign(sorted_unique, detail::deref_iterator<const typename Map::value_type>(buffer.data()),
+                 detail::deref_iterator<const typename Map::value_type>(buffer.data() + kept));
+   return result;
+}
+
+/**
+* the same with a default constructed comparator.
+*/
+template<class Map, class InputIt>
+Map parallel_build(InputIt first, InputIt last, thread_pool &pool = default_pool()) {
+   return parallel_build<Map>(first, last, typename detail::compare_of<Map>::type(), pool);
+}
+
+/**
+* the union of a and b; for keys in both, the element of a is taken.
+*   Both element sequences are gathered and merged on the threads of pool.
+*   a and b must be ordered alike; the result takes the comparator of a.
+*/
+template<class Key, class T, class Compare, class Policy>
+map<Key, T, Compare, Policy> parallel_union(const map<Key, T, Compare, Policy> &a, const map<Key, T, Compare, Policy> &b,
+                                            thread_pool &pool = default_pool()) {
+   typedef map<Key, T, Compare, Policy> Map;
+   typedef const typename Map::value_type *pointer;
+   std::vector<pointer> x = detail::map_access::flatten(a, pool), y = detail::map_access::flatten(b, pool);
+   std::vector<pointer> merged(x.size() + y.size()), out(merged.size());
+   detail::key_less<const typename Map::value_type, Compare> less = {a.key_comp()};
+   detail::parallel_merge(x.data(), x.size(), y.data(), y.size(), merged.data(), less, pool);
+   size_t kept = detail::parallel_filter(merged.data(), merged.size(), out.data(), [&less](const pointer *in, size_t, size_t k) {
+       return k == 0 || less(in[k - 1], in[k]);
+   }, pool);
+   Map result(a.key_comp());
+   result.assign(sorted_unique, detail::deref_iterator<const typename Map::value_type>(out.data()),
+                 detail::deref_iterator<const typename Map::value_type>(out.data() + kept));
+   return result;
+}
+
+/**
+* the elements of a whose keys are also in b, found on the threads of pool.
+*   a and b must be ordered alike; the result takes the comparator of a.
+*/
+template<class Key, class T, class Compare, class Policy>
+map<Key, T, Compare, Policy> parallel_intersection(const map<Key, T, Compare, Policy> &a, const map<Key, T, Compare, Policy> &b,
+                                                   thread_pool &pool = default_pool()) {
+   typedef map<Key, T, Compare, Policy> Map;
+   typedef const typename Map::value_type *pointer;
+   std::vector<pointer> x = detail::map_access::flatten(a, pool), y = detail::map_access::flatten(b, pool);
+   std::vector<pointer> merged(x.size() + y.size()), out(std::min(x.size(), y.size()));
+   detail::key_less<const typename Map::value_type, Compare> less = {a.key_comp()};
+   detail::parallel_merge(x.data(), x.size(), y.data(), y.size(), merged.data(), less, pool);
+   // a key in both shows up twice in a row, a's element first
+   size_t kept = detail::parallel_filter(merged.data(), merged.size(), out.data(), [&less](const pointer *in, size_t n, size_t k) {
+       return k + 1 < n && !less(in[k], in[k + 1]);
+   }, pool);
+   Map result(a.key_comp());
+   result.assign(sorted_unique, detail::deref_iterator<const typename Map::value_type>(out.data()),
+                 detail::deref_iterator<const typename Map::value_type>(out.data() + kept));
+   return result;
+}
+
+}
+
+#endif
@@ -0,0 +1,617 @@
+/**
+* a map whose copies share structure
+*/
+#ifndef SJTU_PERSISTENT_MAP_HPP
+#define SJTU_PERSISTENT_MAP_HPP
+
+#include <functional>
+#include <atomic>
+#include <cstddef>
+#include "utility.hpp"
+#include "exceptions.hpp"
+
+namespace sjtu {
+
+/**
+* an ordered map with O(1) copies.
+*
+* the tree is an AVL tree of reference counted nodes. Copying a map (or calling
+*   snapshot()) only takes a reference to the root; a later write copies the
+*   nodes on its search path that are still shared and changes the copies, so
+*   every other map keeps seeing the tree it had. Nodes owned by one map only
+*   are changed in place, which makes writes to an unshared map as cheap as
+*   usual.
+*
+* elements are read only through iterators (iterator is const_iterator, as in
+*   std::set): writing through one could reach a shared node. Use at(),
+*   operator[] or insert_or_assign() to change a value; the reference they
+*   return is good until the map is copied or written again.
+*
+* iterators and references of a map are invalidated by writes to that map,
+*   never by writes to its copies. Distinct maps may be used from different
+*   threads even while they share nodes; one map is not thread safe.
+*/
+template<
+   class Key,
+   class T,
+   class Compare = std::less <Key>
+   > class persistent_map {
+public:
+   typedef pair<const Key, T> value_type;
+
+private:
+   struct Node {
+       Node *left, *right;
+       std::atomic<size_t> refs; // links (and roots) pointing here
+       int height;
+       value_type data;
+
+       template<class... Args>
+       explicit Node(Args &&...args) : left(nullptr), right(nullptr), refs(1), height(1),
+                                       data(std::forward<Args>(args)...) {}
+   };
+
+   // An AVL tree of n nodes is less than 1.45 * log2(n + 2) high, so this
+   // covers any tree that fits in memory.
+   static const int MAX_DEPTH = 64;
+
+   Node *root;
+   size_t map_size;
+   Compare comp;
+
+   static void retain(Node *x) {
+       if (x != nullptr) x->refs.fetch_add(1, std::memory_order_relaxed);
+   }
+
+   // Drops one reference; the last one frees the node and releases its children.
+   static void release(Node *x) {
+       while (x != nullptr && x->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+           release(x->left);
+           Node *next = x->right;
+           delete x;
+           x = next;
+       }
+   }
+
+   static bool shared(const Node *x) {
+       return x->refs.load(std::memory_order_acquire) != 1;
+   }
+
+   static int height(const Node *x) {
+       return x == nullptr ? 0 : x->height;
+   }
+
+   static void update(Node *x) {
+       int l = height(x->left), r = height(x->right);
+       x->height = (l > r ? l : r) + 1;
+   }
+
+   // Makes the node behind link private to this map, copying it if another
+   // link shares it. The copy shares the children. If copying throws, link is
+   // left as it was.
+   static void own(Node *&link) {
+       Node *x = link;
+       if (!shared(x)) return;
+       Node *y = new Node(x->data);
+       y->left = x->left;
+       y->right = x->right;
+       y->height = x->height;
+       retain(y->left);
+       retain(y->right);
+       link = y;
+       release(x);
+   }
+
+   static bool tryOwn(Node *&link) noexcept {
+       try {
+           own(link);
+           return true;
+       } catch (...) {
+           return false;
+       }
+   }
+
+   // Rotations only ever see nodes owned by this map.
+   static Node *rotateRight(Node *y) {
+       Node *x = y->left;
+       y->left = x->right;
+       x->right = y;
+       update(y);
+       update(x);
+       return x;
+   }
+
+   static Node *rotateLeft(Node *y) {
+       Node *x = y->right;
+       y->right = x->left;
+       x->left = y;
+       update(y);
+       update(x);
+       return x;
+   }
+
+   // Restores the AVL condition at the owned node y after one of its subtrees
+   // grew or shrank by one. After an insertion the rotated nodes are on the
+   // (already private) search path; after an erase they may be shared and are
+   // copied first. If a copy fails the rotation is skipped, which costs
+   // balance but keeps every element in order, so erase never throws from here.
+   Node *balance(Node *y) {
+       update(y);
+       int diff = height(y->left) - height(y->right);
+       if (diff > 1) {
+           if (!tryOwn(y->left)) return y;
+           Node *l = y->left;
+           if (height(l->left) < height(l->right)) {
+               if (!tryOwn(l->right)) return y;
+               y->left = rotateLeft(l);
+           }
+           return rotateRight(y);
+       }
+       if (diff < -1) {
+           if (!tryOwn(y->right)) return y;
+           Node *r = y->right;
+           if (height(r->right) < height(r->left)) {
+               if (!tryOwn(r->left)) return y;
+               y->right = rotateRight(r);
+           }
+           return rotateLeft(y);
+       }
+       return y;
+   }
+
+   const Node *findNode(const Key &key) const {
+       const Node *x = root;
+       while (x != nullptr) {
+           if (comp(key, x->data.first)) {
+               x = x->left;
+           } else if (comp(x->data.first, key)) {
+               x = x->right;
+           } else {
+               return x;
+           }
+       }
+       return nullptr;
+   }
+
+   // Links z, whose key is absent, below link. Throws only while copying the
+   // search path, and then the contents are unchanged.
+   void insertAt(Node *&link, Node *z) {
+       if (link == nullptr) {
+           link = z;
+           return;
+       }
+       own(link);
+       Node *y = link;
+       if (comp(z->data.first, y->data.first)) {
+           insertAt(y->left, z);
+       } else {
+           insertAt(y->right, z);
+       }
+       link = balance(y);
+   }
+
+   // Unlinks the smallest node below link and returns it, private to this map.
+   Node *detachMin(Node *&link) {
+       own(link);
+       Node *x = link;
+       if (x->left == nullptr) {
+           link = x->right;
+           x->right = nullptr;
+           return x;
+       }
+       Node *m = detachMin(x->left);
+       link = balance(x);
+       return m;
+   }
+
+   // Unlinks the node behind link. key may live in that node: it is not
+   // compared again once the node is gone.
+   void removeAt(Node *&link) {
+       Node *x = link;
+       if (x->left == nullptr || x->right == nullptr) {
+           Node *c = x->left != nullptr ? x->left : x->right;
+           retain(c);
+           link = c;
+           release(x);
+           return;
+       }
+       Node *l, *r, *s;
+       if (!shared(x)) {
+           s = detachMin(x->right);
+           l = x->left;
+           r = x->right;
+           x->left = x->right = nullptr;
+       } else {
+           // x stays in other maps, so it keeps its children
+           r = x->right;
+           retain(r);
+           try {
+               s = detachMin(r);
+           } catch (...) {
+               release(r);
+               throw;
+           }
+           l = x->left;
+           retain(l);
+       }
+       s->left = l;
+       s->right = r;
+       link = balance(s);
+       release(x);
+   }
+
+   // Removes key, which is present, from below link.
+   void eraseAt(Node *&link, const Key &key) {
+       Node *x = link;
+       if (comp(key, x->data.first)) {
+           own(link);
+           eraseAt(link->left, key);
+           link = balance(link);
+       } else if (comp(x->data.first, key)) {
+           own(link);
+           eraseAt(link->right, key);
+           link = balance(link);
+       } else {
+           removeAt(link);
+       }
+   }
+
+   // Makes every node on the way down to key (which is present) private to
+   // this map and returns key's node, so it may be written.
+   Node *ownPath(const Key &key) {
+       Node **link = &root;
+       while (true) {
+           own(*link);
+           Node *x = *link;
+           if (comp(key, x->data.first)) {
+               link = &x->left;
+           } else if (comp(x->data.first, key)) {
+               link = &x->right;
+           } else {
+               return x;
+           }
+       }
+   }
+
+   template<class... Args>
+   Node *insertNode(Args &&...args) {
+       Node *z = new Node(std::forward<Args>(args)...);
+       try {
+           insertAt(root, z);
+       } catch (...) {
+           delete z;
+           throw;
+       }
+       map_size++;
+       return z;
+   }
+
+   // Searches published versions directly, without building an iterator.
+   template<class, class, class> friend class concurrent_map;
+
+public:
+   /**
+  * see BidirectionalIterator at CppReference for help.
+  *
+  * if there is anything wrong throw invalid_iterator.
+  *     like it = map.begin(); --it;
+  *       or it = map.end(); ++end();
+  *
+  * the iterator keeps the path from the root, as nodes have no parent links.
+    */
+   class const_iterator {
+   private:
+       const Node *path[MAX_DEPTH]; // path[depth - 1] is the element, depth == 0 at end()
+       int depth;
+       const persistent_map *container;
+
+       void descendLeft(const Node *x) {
+           for (; x != nullptr; x = x->left) path[depth++] = x;
+       }
+
+       void descendRight(const Node *x) {
+           for (; x != nullptr; x = x->right) path[depth++] = x;
+       }
+
+   public:
+       const_iterator() : depth(0), container(nullptr) {}
+
+       explicit const_iterator(const persistent_map *cont) : depth(0), container(cont) {}
+
+       const_iterator(const const_iterator &other) : depth(other.depth), container(other.container) {
+           for (int i = 0; i < depth; ++i) path[i] = other.path[i];
+       }
+
+       const_iterator &operator=(const const_iterator &other) {
+           depth = other.depth;
+           container = other.container;
+           for (int i = 0; i < depth; ++i) path[i] = other.path[i];
+           return *this;
+       }
+
+       const_iterator operator++(int) {
+           const_iterator temp = *this;
+           ++(*this);
+           return temp;
+       }
+
+       const_iterator &operator++() {
+           if (depth == 0) throw invalid_iterator();
+           const Node *x = path[depth - 1];
+           if (x->right != nullptr) {
+               descendLeft(x->right);
+               return *this;
+           }
+           --depth;
+           while (depth > 0 && path[depth - 1]->right == x) x = path[--depth];
+           return *this;
+       }
+
+       const_iterator operator--(int) {
+           const_iterator temp = *this;
+           --(*this);
+           return temp;
+       }
+
+       const_iterator &operator--() {
+           if (container == nullptr) throw invalid_iterator();
+           if (depth == 0) {
+               if (container->root == nullptr) throw invalid_iterator();
+               descendRight(container->root);
+               return *this;
+           }
+           const Node *x = path[depth - 1];
+           if (x->left != nullptr) {
+               descendRight(x->left);
+               return *this;
+           }
+           int d = depth - 1;
+           while (d > 0 && path[d - 1]->left == x) x = path[--d];
+           if (d == 0) throw invalid_iterator(); // x was the first element
+           depth = d;
+           return *this;
+       }
+
+       const value_type &operator*() const {
+           if (depth == 0) throw invalid_iterator();
+           return path[depth - 1]->data;
+       }
+
+       const value_type *operator->() const {
+           if (depth == 0) throw invalid_iterator();
+           return &path[depth - 1]->data;
+       }
+
+       bool operator==(const const_iterator &rhs) const {
+           if (container != rhs.container || depth == 0 || rhs.depth == 0) {
+               return container == rhs.container && depth == rhs.depth;
+           }
+           return path[depth - 1] == rhs.path[rhs.depth - 1];
+       }
+
+       bool operator!=(const const_iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       friend class persistent_map;
+   };
+
+   typedef const_iterator iterator;
+
+private:
+   // Iterator at the first element whose key is not less (Upper: greater) than key.
+   template<bool Upper>
+   const_iterator bound(const Key &key) const {
+       const_iterator it(this);
+       int keep = 0;
+       for (const Node *x = root; x != nullptr;) {
+           it.path[it.depth++] = x;
+           if (Upper ? comp(key, x->data.first) : !comp(x->data.first, key)) {
+               keep = it.depth;
+               x = x->left;
+           } else {
+               x = x->right;
+           }
+       }
+       it.depth = keep;
+       return it;
+   }
+
+   const_iterator iteratorAt(const Key &key) const {
+       const_iterator it(this);
+       for (const Node *x = root; x != nullptr;) {
+           it.path[it.depth++] = x;
+           if (comp(key, x->data.first)) {
+               x = x->left;
+           } else if (comp(x->data.first, key)) {
+               x = x->right;
+           } else {
+               return it;
+           }
+       }
+       it.depth = 0;
+       return it;
+   }
+
+public:
+   persistent_map() : root(nullptr), map_size(0) {}
+
+   /**
+    * O(1): the copy shares every node with other.
+    */
+   persistent_map(const persistent_map &other) : root(other.root), map_size(other.map_size), comp(other.comp) {
+       retain(root);
+   }
+
+   persistent_map(persistent_map &&other) noexcept : root(other.root), map_size(other.map_size), comp(other.comp) {
+       other.root = nullptr;
+       other.map_size = 0;
+   }
+
+   persistent_map &operator=(const persistent_map &other) {
+       if (this == &other) return *this;
+       retain(other.root);
+       release(root);
+       root = other.root;
+       map_size = other.map_size;
+       comp = other.comp;
+       return *this;
+   }
+
+   persistent_map &operator=(persistent_map &&other) noexcept {
+       if (this == &other) return *this;
+       clear();
+       swap(other);
+       return *this;
+   }
+
+   ~persistent_map() {
+       release(root);
+   }
+
+   /**
+    * an O(1) copy of the current contents, unaffected by later writes to this map.
+    */
+   persistent_map snapshot() const {
+       return *this;
+   }
+
+   void swap(persistent_map &other) noexcept {
+       std::swap(root, other.root);
+       std::swap(map_size, other.map_size);
+       std::swap(comp, other.comp);
+   }
+
+   /**
+  * access specified element with bounds checking.
+  * If no such element exists, an exception of type `index_out_of_bound'
+    */
+   T &at(const Key &key) {
+       if (findNode(key) == nullptr) throw index_out_of_bound();
+       return ownPath(key)->data.second;
+   }
+
+   const T &at(const Key &key) const {
+       const Node *x = findNode(key);
+       if (x == nullptr) throw index_out_of_bound();
+       return x->data.second;
+   }
+
+   /**
+  * access specified element, performing an insertion if such key does not already exist.
+    */
+   T &operator[](const Key &key) {
+       if (findNode(key) != nullptr) return ownPath(key)->data.second;
+       return insertNode(key, T())->data.second;
+   }
+
+   /**
+  * behave like at() throw index_out_of_bound if such key does not exist.
+    */
+   const T &operator[](const Key &key) const {
+       return at(key);
+   }
+
+   const_iterator begin() const {
+       const_iterator it(this);
+       it.descendLeft(root);
+       return it;
+   }
+
+   const_iterator cbegin() const {
+       return begin();
+   }
+
+   const_iterator end() const {
+       return const_iterator(this);
+   }
+
+   const_iterator cend() const {
+       return end();
+   }
+
+   bool empty() const {
+       return map_size == 0;
+   }
+
+   size_t size() const {
+       return map_size;
+   }
+
+   void clear() {
+       release(root);
+       root = nullptr;
+       map_size = 0;
+   }
+
+   /**
+  * insert an element.
+  * return a pair, the first of the pair is
+  *   the iterator to the new element (or the element that prevented the insertion),
+  *   the second one is true if insert successfully, or false.
+    */
+   pair<iterator, bool> insert(const value_type &value) {
+       if (findNode(value.first) != nullptr) return pair<iterator, bool>(iteratorAt(value.first), false);
+       const Key &key = insertNode(value)->data.first;
+       return pair<iterator, bool>(iteratorAt(key), true);
+   }
+
+   /**
+    * insert value, or assign obj to the element already there.
+    */
+   template<class M>
+   pair<iterator, bool> insert_or_assign(const Key &key, M &&obj) {
+       if (findNode(key) != nullptr) {
+           ownPath(key)->data.second = std::forward<M>(obj);
+           return pair<iterator, bool>(iteratorAt(key), false);
+       }
+       const Key &at_key = insertNode(key, std::forward<M>(obj))->data.first;
+       return pair<iterator, bool>(iteratorAt(at_key), true);
+   }
+
+   /**
+  * erase the element at pos.
+  *
+  * throw if pos pointed to a bad element (pos == this->end() || pos points an element out of this)
+    */
+   void erase(iterator pos) {
+       if (pos.container != this || pos.depth == 0) throw invalid_iterator();
+       eraseAt(root, pos->first);
+       map_size--;
+   }
+
+   /**
+  * erase the element with key, return the number of elements removed (0 or 1).
+    */
+   size_t erase(const Key &key) {
+       if (findNode(key) == nullptr) return 0;
+       eraseAt(root, key);
+       map_size--;
+       return 1;
+   }
+
+   size_t count(const Key &key) const {
+       return findNode(key) != nullptr ? 1 : 0;
+   }
+
+   const_iterator find(const Key &key) const {
+       return iteratorAt(key);
+   }
+
+   const_iterator lower_bound(const Key &key) const {
+       return bound<false>(key);
+   }
+
+   const_iterator upper_bound(const Key &key) const {
+       return bound<true>(key);
+   }
+};
+
+template<class Key, class T, class Compare>
+void swap(persistent_map<Key, T, Compare> &lhs, persistent_map<Key, T, Compare> &rhs) noexcept {
+   lhs.swap(rhs);
+}
+
+}
+
+#endif
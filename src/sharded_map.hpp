@@ -0,0 +1,513 @@
+/**
+* a map split into independently locked key ranges
+*/
+#ifndef SJTU_SHARDED_MAP_HPP
+#define SJTU_SHARDED_MAP_HPP
+
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <cstddef>
+#include "utility.hpp"
+#include "exceptions.hpp"
+#include "map.hpp"
+
+namespace sjtu {
+
+/**
+* an ordered map for many writer threads.
+*
+* the key space is cut into ranges, each held by a shard: an sjtu::map with a
+*   lock of its own, so writes to different ranges run in parallel. A shard
+*   that grows past split_size is split at its median; the upper half is
+*   cut off into a new shard by map::split(), without copying an element.
+*   The list of shards is an immutable directory replaced on every split,
+*   so finding the shard of a key takes no lock.
+*
+* all the single key operations are safe to call from any thread. Iterators
+*   walk the shards in key order and see one ordered sequence, but they are
+*   only safe while no other thread writes.
+*/
+template<
+   class Key,
+   class T,
+   class Compare = std::less <Key>
+   > class sharded_map {
+public:
+   typedef pair<const Key, T> value_type;
+   typedef map<Key, T, Compare> shard_type;
+
+private:
+   struct Shard {
+       std::mutex lock;
+       shard_type data;
+       const Key *lower; // owned; nullptr for the first shard
+       const Key *upper; // the next shard's lower, guarded by lock; nullptr for the last
+
+       Shard(const Key *lo, const Key *hi) : lower(lo), upper(hi) {}
+
+       ~Shard() {
+           delete lower;
+       }
+   };
+
+   static const size_t MAX_SHARDS = 256;
+
+   // Shards in key order. A directory never changes once published; splits
+   // publish a new one and keep the old for lookups still using it.
+   struct Directory {
+       size_t count;
+       Shard *shards[MAX_SHARDS];
+       Directory *older;
+   };
+
+   std::atomic<Directory *> directory;
+   // Serializes splits. The two halves of a split share node memory, and
+   // shards give it back only under this lock too (see clear()).
+   std::mutex split_lock;
+   size_t split_size;
+   Compare comp;
+
+   // The last shard whose lower bound is not above key. Lower bounds never
+   // change, so this needs no lock; the upper bound is checked under the
+   // shard's lock.
+   size_t shardIndex(const Directory *dir, const Key &key) const {
+       size_t lo = 1, hi = dir->count;
+       while (lo < hi) {
+           size_t mid = (lo + hi) / 2;
+           if (comp(key, *dir->shards[mid]->lower)) {
+               hi = mid;
+           } else {
+               lo = mid + 1;
+           }
+       }
+       return lo - 1;
+   }
+
+   // Locks and returns the shard holding key. A split may move key to a new
+   // shard between the lookup and the lock; then the lookup is redone.
+   Shard *lockShard(const Key &key) const {
+       while (true) {
+           const Directory *dir = directory.load(std::memory_order_acquire);
+           Shard *x = dir->shards[shardIndex(dir, key)];
+           x->lock.lock();
+           if (x->upper == nullptr || comp(key, *x->upper)) return x;
+           x->lock.unlock();
+       }
+   }
+
+   class ShardGuard {
+   private:
+       Shard *x;
+
+   public:
+       ShardGuard(const sharded_map *m, const Key &key) : x(m->lockShard(key)) {}
+
+       ~ShardGuard() {
+           x->lock.unlock();
+       }
+
+       shard_type &data() const {
+           return x->data;
+       }
+
+       Shard *shard() const {
+           return x;
+       }
+   };
+
+   // Moves the upper half of x (locked by the caller) into a new shard.
+   void split(Shard *x) {
+       std::lock_guard<std::mutex> guard(split_lock);
+       Directory *dir = directory.load();
+       if (dir->count == MAX_SHARDS || x->data.size() < 2) return;
+       size_t at = 0;
+       while (dir->shards[at] != x) ++at;
+
+       typename shard_type::const_iterator mid = x->data.cbegin();
+       for (size_t i = x->data.size() / 2; i > 0; --i) ++mid;
+       Directory *next = new Directory(*dir);
+       Key *boundary = nullptr;
+       Shard *y = nullptr;
+       try {
+           boundary = new Key(mid->first);
+           y = new Shard(boundary, x->upper);
+           boundary = nullptr;
+           y->data = x->data.split(*y->lower);
+       } catch (...) {
+           delete next;
+           delete boundary;
+           delete y;
+           throw;
+       }
+       x->upper = y->lower;
+
+       for (size_t i = next->count; i > at + 1; --i) next->shards[i] = next->shards[i - 1];
+       next->shards[at + 1] = y;
+       next->count++;
+       next->older = dir;
+       directory.store(next, std::memory_order_release);
+   }
+
+   void splitIfLarge(const ShardGuard &guard) {
+       if (guard.data().size() > split_size) split(guard.shard());
+   }
+
+   void init(const Key *first, const Key *last) {
+       Directory *dir = new Directory;
+       dir->count = 0;
+       dir->older = nullptr;
+       try {
+           dir->shards[dir->count++] = new Shard(nullptr, nullptr);
+           for (; first != last && dir->count < MAX_SHARDS; ++first) {
+               const Key *previous = dir->shards[dir->count - 1]->lower;
+               if (previous != nullptr && !comp(*previous, *first)) continue; // keep boundaries increasing
+               Shard *y = new Shard(nullptr, nullptr);
+               try {
+                   y->lower = new Key(*first);
+               } catch (...) {
+                   delete y;
+                   throw;
+               }
+               dir->shards[dir->count - 1]->upper = y->lower;
+               dir->shards[dir->count++] = y;
+           }
+       } catch (...) {
+           for (size_t i = 0; i < dir->count; ++i) delete dir->shards[i];
+           delete dir;
+           throw;
+       }
+       directory.store(dir);
+   }
+
+public:
+   /**
+    * iterators visit the shards one after the other.
+    *
+    * if there is anything wrong throw invalid_iterator.
+    */
+   class const_iterator;
+   class iterator {
+   private:
+       const sharded_map *container;
+       size_t index; // shard; the directory count at end()
+       typename shard_type::iterator at;
+
+   public:
+       iterator() : container(nullptr), index(0) {}
+
+       iterator(const sharded_map *cont, size_t i, typename shard_type::iterator it)
+           : container(cont), index(i), at(it) {}
+
+       iterator operator++(int) {
+           iterator temp = *this;
+           ++(*this);
+           return temp;
+       }
+
+       iterator &operator++() {
+           if (container == nullptr) throw invalid_iterator();
+           const Directory *dir = container->directory.load();
+           if (index >= dir->count) throw invalid_iterator();
+           ++at;
+           container->skipEmpty(dir, index, at);
+           return *this;
+       }
+
+       iterator operator--(int) {
+           iterator temp = *this;
+           --(*this);
+           return temp;
+       }
+
+       iterator &operator--() {
+           if (container == nullptr) throw invalid_iterator();
+           const Directory *dir = container->directory.load();
+           size_t i = index;
+           typename shard_type::iterator it = at;
+           while (i == dir->count || it == dir->shards[i]->data.begin()) {
+               if (i == 0) throw invalid_iterator();
+               --i;
+               it = dir->shards[i]->data.end();
+           }
+           --it;
+           index = i;
+           at = it;
+           return *this;
+       }
+
+       value_type &operator*() const {
+           return *at;
+       }
+
+       value_type *operator->() const {
+           return &*at;
+       }
+
+       bool operator==(const iterator &rhs) const {
+           return container == rhs.container && index == rhs.index && at == rhs.at;
+       }
+
+       bool operator==(const const_iterator &rhs) const {
+           return const_iterator(*this) == rhs;
+       }
+
+       bool operator!=(const iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       bool operator!=(const const_iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       friend class sharded_map;
+       friend class const_iterator;
+   };
+
+   class const_iterator {
+   private:
+       const sharded_map *container;
+       size_t index;
+       typename shard_type::const_iterator at;
+
+   public:
+       const_iterator() : container(nullptr), index(0) {}
+
+       const_iterator(const sharded_map *cont, size_t i, typename shard_type::const_iterator it)
+           : container(cont), index(i), at(it) {}
+
+       const_iterator(const iterator &other) : container(other.container), index(other.index), at(other.at) {}
+
+       const_iterator operator++(int) {
+           const_iterator temp = *this;
+           ++(*this);
+           return temp;
+       }
+
+       const_iterator &operator++() {
+           if (container == nullptr) throw invalid_iterator();
+           const Directory *dir = container->directory.load();
+           if (index >= dir->count) throw invalid_iterator();
+           ++at;
+           container->skipEmpty(dir, index, at);
+           return *this;
+       }
+
+       const_iterator operator--(int) {
+           const_iterator temp = *this;
+           --(*this);
+           return temp;
+       }
+
+       const_iterator &operator--() {
+           if (container == nullptr) throw invalid_iterator();
+           const Directory *dir = container->directory.load();
+           size_t i = index;
+           typename shard_type::const_iterator it = at;
+           while (i == dir->count || it == dir->shards[i]->data.cbegin()) {
+               if (i == 0) throw invalid_iterator();
+               --i;
+               it = dir->shards[i]->data.cend();
+           }
+           --it;
+           index = i;
+           at = it;
+           return *this;
+       }
+
+       const value_type &operator*() const {
+           return *at;
+       }
+
+       const value_type *operator->() const {
+           return &*at;
+       }
+
+       bool operator==(const const_iterator &rhs) const {
+           return container == rhs.container && index == rhs.index && at == rhs.at;
+       }
+
+       bool operator==(const iterator &rhs) const {
+           return *this == const_iterator(rhs);
+       }
+
+       bool operator!=(const const_iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       bool operator!=(const iterator &rhs) const {
+           return !(*this == rhs);
+       }
+
+       friend class sharded_map;
+   };
+
+private:
+   // Moves an iterator sitting at the end of its shard on to the next element.
+   template<class It>
+   void skipEmpty(const Directory *dir, size_t &index, It &at) const {
+       while (index < dir->count && at == It(dir->shards[index]->data.end())) {
+           if (++index < dir->count) at = It(dir->shards[index]->data.begin());
+       }
+       if (index == dir->count) at = It();
+   }
+
+public:
+   /**
+    * a shard is split in two once it holds more than split_size elements.
+    */
+   explicit sharded_map(size_t split_size_ = 4096) : split_size(split_size_) {
+       init(nullptr, nullptr);
+   }
+
+   /**
+    * starts with one shard per range between consecutive keys of [first, last),
+    *   for key spaces whose distribution is known up front. The keys must be sorted.
+    */
+   sharded_map(const Key *first, const Key *last, size_t split_size_ = 4096) : split_size(split_size_) {
+       init(first, last);
+   }
+
+   sharded_map(const sharded_map &) = delete;
+
+   sharded_map &operator=(const sharded_map &) = delete;
+
+   /**
+    * no thread may use the map any more.
+    */
+   ~sharded_map() {
+       Directory *dir = directory.load();
+       for (size_t i = 0; i < dir->count; ++i) delete dir->shards[i];
+       while (dir != nullptr) {
+           Directory *older = dir->older;
+           delete dir;
+           dir = older;
+       }
+   }
+
+   /**
+    * the value stored under key, copied into value; false if there is none.
+    */
+   bool find(const Key &key, T &value) const {
+       ShardGuard guard(this, key);
+       typename shard_type::const_iterator it = static_cast<const shard_type &>(guard.data()).find(key);
+       if (it == guard.data().cend()) return false;
+       value = it->second;
+       return true;
+   }
+
+   /**
+    * the value stored under key. If there is none, an exception of type `index_out_of_bound'
+    */
+   T at(const Key &key) const {
+       ShardGuard guard(this, key);
+       return static_cast<const shard_type &>(guard.data()).at(key);
+   }
+
+   size_t count(const Key &key) const {
+       ShardGuard guard(this, key);
+       return guard.data().count(key);
+   }
+
+   /**
+    * insert value if its key is absent; return whether it was inserted.
+    */
+   bool insert(const value_type &value) {
+       ShardGuard guard(this, value.first);
+       if (!guard.data().insert(value).second) return false;
+       splitIfLarge(guard);
+       return true;
+   }
+
+   /**
+    * insert value, or assign obj to the element already there; return whether it was inserted.
+    */
+   template<class M>
+   bool insert_or_assign(const Key &key, M &&obj) {
+       ShardGuard guard(this, key);
+       bool inserted = guard.data().insert_or_assign(key, std::forward<M>(obj)).second;
+       if (inserted) splitIfLarge(guard);
+       return inserted;
+   }
+
+   /**
+    * calls f on the value under key (default constructed first if absent)
+    *   while its shard is locked, for read-modify-write updates.
+    */
+   template<class F>
+   void update(const Key &key, F &&f) {
+       ShardGuard guard(this, key);
+       size_t before = guard.data().size();
+       f(guard.data()[key]);
+       if (guard.data().size() != before) splitIfLarge(guard);
+   }
+
+   /**
+  * erase the element with key, return the number of elements removed (0 or 1).
+    */
+   size_t erase(const Key &key) {
+       ShardGuard guard(this, key);
+       return guard.data().erase(key);
+   }
+
+   /**
+    * the sum of the shard sizes, each read under its lock; not a snapshot.
+    */
+   size_t size() const {
+       const Directory *dir = directory.load(std::memory_order_acquire);
+       size_t total = 0;
+       for (size_t i = 0; i < dir->count; ++i) {
+           std::lock_guard<std::mutex> guard(dir->shards[i]->lock);
+           total += dir->shards[i]->data.size();
+       }
+       return total;
+   }
+
+   bool empty() const {
+       return size() == 0;
+   }
+
+   /**
+    * empties every shard; the shard boundaries stay.
+    */
+   void clear() {
+       const Directory *dir = directory.load(std::memory_order_acquire);
+       for (size_t i = 0; i < dir->count; ++i) {
+           std::lock_guard<std::mutex> guard(dir->shards[i]->lock);
+           std::lock_guard<std::mutex> release(split_lock);
+           dir->shards[i]->data.clear();
+       }
+   }
+
+   size_t shard_count() const {
+       return directory.load(std::memory_order_acquire)->count;
+   }
+
+   iterator begin() {
+       const Directory *dir = directory.load();
+       size_t index = 0;
+       typename shard_type::iterator at = dir->shards[0]->data.begin();
+       skipEmpty(dir, index, at);
+       return iterator(this, index, at);
+   }
+
+   const_iterator cbegin() const {
+       const Directory *dir = directory.load();
+       size_t index = 0;
+       typename shard_type::const_iterator at = dir->shards[0]->data.cbegin();
+       skipEmpty(dir, index, at);
+       return const_iterator(this, index, at);
+   }
+
+   iterator end() {
+       return iterator(this, directory.load()->count, typename shard_type::iterator());
+   }
+
+   const_iterator cend() const {
+       return const_iterator(this, directory.load()->count, typename shard_type::const_iterator());
+   }
+};
+
+}
+
+#endif
@@ -15,11 +15,11 @@ class pair {
     pair(pair &&other) = default;
     pair(const T1 &x, const T2 &y) : first(x), second(y) {}
     template<class U1, class U2>
-    pair(U1 &&x, U2 &&y) : first(x), second(y) {}
+    pair(U1 &&x, U2 &&y) : first(std::forward<U1>(x)), second(std::forward<U2>(y)) {}
     template<class U1, class U2>
     pair(const pair<U1, U2> &other) : first(other.first), second(other.second) {}
     template<class U1, class U2>
-    pair(pair<U1, U2> &&other) : first(other.first), second(other.second) {}
+    pair(pair<U1, U2> &&other) : first(std::move(other.first)), second(std::move(other.second)) {}
 };
 
 }